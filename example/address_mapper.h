@@ -0,0 +1,108 @@
+#ifndef ADDRESS_MAPPER_H
+#define ADDRESS_MAPPER_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/**
+ * Compiled physical-address <-> DRAM-coordinate mapping.
+ *
+ * Both mapping formats are compiled into the same GF(2) bit matrix: every coordinate bit is
+ * the XOR (parity) of a set of line-address bits, where the line address is the device
+ * address without its `byte_bits` byte-index bits. The inverse matrix is computed once, so
+ * translation in both directions is a fixed sequence of AND + parity operations.
+ *
+ * Sources:
+ *  - ramulator .map files (`Co 9:0 = 9:0`, `Ch 0 = 4 10` for XOR terms, `Burst_length 16`)
+ *  - YAML files with `mapping: bit_mapping:` lists (bit i of a field is the listed address bit,
+ *    a nested list such as `channel: [[4, 10]]` is an XOR term) and `dram: interface: DQ`.
+ */
+class AddressMapper {
+public:
+    enum class Field : int {
+        Channel, Rank, BankGroup, Bank, Row, Column, MAX
+    };
+    // level names as used in .map files
+    static const char* field_str[int(Field::MAX)];
+
+    struct DramCoord {
+        uint32_t level[int(Field::MAX)];
+    };
+
+    // translation kernel, chosen once when the mapping is compiled
+    enum class Kernel {
+        Parity, // one AND + parity per coordinate bit (reference)
+        Nibble, // XOR of one 16-entry table per address nibble (portable)
+        Bmi2,   // pext/pdep per field, x86 with BMI2 and XOR-free, field bits in ascending or descending order
+        Neon,   // the nibble tables as byte tables, 16 addresses per vqtbl1q_u8 lookup (AArch64)
+    };
+
+    AddressMapper() : byte_bits(0), burst_length(0), packed_bits(0), kernel(Kernel::Parity), fwd_planes(0), inv_planes(0) {}
+
+    static AddressMapper fromMapFile(const std::string& filename, int byte_bits);
+    static AddressMapper fromYaml(const std::string& filename);
+    // already compiled matrices (e.g., from a device profile); throws if they do not match the terms
+    static AddressMapper fromCompiled(const std::vector<std::vector<int>> terms[], int byte_bits, int burst_length,
+                                      const uint64_t* fwd, size_t fwd_count, const uint64_t* inv);
+    // .yaml/.yml files are read as YAML, .remu files as a device profile (see device_profile.h),
+    // everything else as a ramulator .map file
+    static AddressMapper load(const std::string& filename, int map_byte_bits);
+
+    int byte_bits;     // device-address bits below the mapping (DQ)
+    int burst_length;  // Burst_length of a .map file, 0 if not given
+
+    int width(Field f) const { return int(field_terms[int(f)].size()); }
+    // source address bits (XOR-ed together) of each bit of a field
+    const std::vector<std::vector<int>>& terms(Field f) const { return field_terms[int(f)]; }
+    bool has_xor() const;
+    int coord_bits() const { return packed_bits; }
+    const std::vector<uint64_t>& forward_rows() const { return fwd_rows; }
+    const std::vector<uint64_t>& inverse_rows() const { return inv_rows; }
+
+    // line address (device address >> byte_bits) <-> packed coordinates
+    uint64_t encode(uint64_t line) const;
+    uint64_t decode(uint64_t packed) const;
+    uint32_t field(uint64_t packed, Field f) const {
+        return static_cast<uint32_t>((packed >> field_offset[int(f)]) & ((1ULL << width(f)) - 1));
+    }
+    uint64_t pack(const DramCoord& coord) const;
+    void unpack(uint64_t packed, DramCoord& coord) const;
+
+    // device address <-> coordinates, `byte` restores the byte-index bits
+    void forward(uintptr_t daddr, DramCoord& coord) const;
+    uintptr_t inverse(const DramCoord& coord, uintptr_t byte = 0) const;
+
+    // batch translation of n entries with the selected kernel, in place if both arrays are the same
+    void encode_batch(const uint64_t* lines, uint64_t* packed, size_t n) const;
+    void decode_batch(const uint64_t* packed, uint64_t* lines, size_t n) const;
+
+    Kernel get_kernel() const { return kernel; }
+    // force a kernel (e.g., for benchmarks); returns false if it cannot express this mapping
+    bool set_kernel(Kernel k);
+    static const char* kernel_str(Kernel k);
+
+private:
+    std::vector<std::vector<int>> field_terms[int(Field::MAX)];
+    int field_offset[int(Field::MAX)];
+    int packed_bits;
+    std::vector<uint64_t> fwd_rows;  // one line-address mask per packed coordinate bit
+    std::vector<uint64_t> inv_rows;  // one packed-coordinate mask per line-address bit (64 entries)
+
+    Kernel kernel;
+    std::vector<uint64_t> fwd_nibble; // [nibble position][nibble value] -> packed coordinates
+    std::vector<uint64_t> inv_nibble; // [nibble position][nibble value] -> line address
+    uint64_t field_mask[int(Field::MAX)]; // Bmi2: source address bits of each field
+    bool field_reverse[int(Field::MAX)];  // Bmi2: descending field, its mask is of the bit-reversed address
+    std::vector<uint8_t> neon_fwd;        // Neon: [nibble position][output byte][nibble value]
+    std::vector<uint8_t> neon_inv;
+    size_t fwd_planes;                    // Neon: output bytes that are not always zero
+    size_t inv_planes;
+    bool pext_ok;
+
+    // build the forward and inverse matrices from field_terms
+    void compile();
+    void compile_kernels();
+};
+
+#endif // ADDRESS_MAPPER_H
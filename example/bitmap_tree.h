@@ -6,11 +6,13 @@
 #include <bitset>
 #include <cstdint>
 #include <map>
+#include "address_mapper.h"
 class BitmapTree {
     
 public:
-    // 构造函数：mapping 为 YAML 文件的路径
-    BitmapTree(const std::string& mapping);
+    // 构造函数：mapping 为 YAML 文件或 ramulator .map 文件的路径
+    // map_byte_bits: .map 文件不含 DQ，物理地址先右移的位数（LPDDR4 x16 为 4）
+    BitmapTree(const std::string& mapping, int map_byte_bits = 4);
     ~BitmapTree();
 
     // 添加物理地址范围 [s_Daddr, t_Daddr]（包含两端）的更新
@@ -28,7 +30,7 @@ private:
     struct ColumnNode {
         int index;  // 列号
         std::bitset<131072> row_bitmap; 
-        int leaf_count; // 此 column 下已置 1 的 row 数
+        uint64_t leaf_count; // 此 column 下已置 1 的 row 数
 
         ColumnNode(int idx) : index(idx), leaf_count(0) {}
     };
@@ -39,7 +41,7 @@ private:
         int index;  
         std::vector<ColumnNode> columns; // 大小为 2^(column_bits)
         std::bitset<1024> column_bitmap;  // 每个位对应一个 column 是否被更新
-        int leaf_count; // 本 bank 下已更新的 column 数（第一次更新时置1）
+        uint64_t leaf_count; // 本 bank 下已置 1 的 row 总数
 
         BankNode(int idx, int num_columns);
     };
@@ -49,7 +51,7 @@ private:
     struct BankGroupNode {
         int index;
         std::vector<BankNode> banks; 
-        int leaf_count;
+        uint64_t leaf_count;
 
         BankGroupNode(int idx, int num_banks, int num_columns);
     };
@@ -58,19 +60,16 @@ private:
     //std::vector<BankGroupNode> bankgroups;
     struct rtNode {
         std::vector<BankGroupNode> bankgroups; 
-        int leaf_count; 
+        uint64_t leaf_count; // 整棵树的叶子数；整个 64GB 器件有 2^31 个叶子，超出 int，各层计数均为 64 位
         rtNode() : leaf_count(0) {}
         rtNode(int num_banks, int num_bankgroups, int num_columns);
     }rt;
 
-    // 从 YAML 文件中解析的映射规则
+    // 编译后的映射规则（YAML 或 .map，支持 XOR）；DQ 为 mapper.byte_bits
+    AddressMapper mapper;
     int dq; // DQ 值：物理地址在映射前先右移 dq 位
-    std::vector<int> map_column;   
-    std::vector<int> map_bankgroup; 
-    std::vector<int> map_bank;    
-    std::vector<int> map_row;     
 
-    // 从 dram->hierarchy 中解析得到的各层位宽（case只用 bankgroup、bank、column、row 四层）
+    // 各层位宽（树只用 bankgroup、bank、column、row 四层；channel、rank 位并入 bankgroup 层）
     int bankgroup_bits;
     int bank_bits;
     int column_bits;
@@ -81,8 +80,18 @@ private:
     int num_columns;
     int num_rows;
 
-    // 根据映射规则从物理地址（处理过 dq 后）中提取对应字段的值
-    int extractField(uintptr_t addr, const std::vector<int>& bits);
+    // 只影响 row 的行地址位：addRange 枚举对齐块时把这些位放在最内层，
+    // 使同一 column 节点的相邻 row 连续更新（同一 cache line），而不是每个叶子都跳到另一个 16KB 的 bitset
+    uint64_t row_only_lines;
+
+    // 把 AddressMapper 翻译后的坐标拆成树的各层索引
+    void extractFields(uint64_t packed, int& bankgroup, int& bank, int& column, int& row) const;
+    // 翻译 n 个行地址并更新树
+    void updateLines(const uint64_t* lines, size_t n);
+    // 各层索引打包成 AddressMapper 的坐标
+    uint64_t packCoord(int bankgroup, int bank, int column, int row) const;
+    // 逆映射：addrs 中的打包坐标批量转换回物理地址，dqs 为各地址的低 dq 位
+    void reverseMapping(std::vector<uintptr_t>& addrs, const std::vector<uintptr_t>& dqs) const;
 
     // 根据 dram 层次信息初始化整棵树
     void initializeTree();
@@ -0,0 +1,226 @@
+#ifndef DEVICE_MODEL_H
+#define DEVICE_MODEL_H
+
+#include "src/Config.h"
+#include "src/LPDDR4.h"
+#include "src/DRAMStandard.h"
+#include "address_mapper.h"
+#include "device_profile.h"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <utility>
+#include <iostream>
+#include <stdexcept>
+#include <ctime>
+
+typedef std::vector<unsigned int> MapSrcVector;
+typedef std::map<unsigned int, MapSrcVector > MapSchemeEntry;
+typedef std::map<unsigned int, MapSchemeEntry> MapScheme;
+
+namespace famulator
+{
+
+// spec construction per family, selected by the type of the last argument
+inline LPDDR4* make_spec(const std::string& standard, const std::string& org, const std::string& speed, LPDDR4*) {
+    if (!LPDDR4::org_map.count(org) || !LPDDR4::speed_map.count(speed))
+        throw std::invalid_argument("Unknown organization or speed for " + standard + ": " + org + ", " + speed);
+    return new LPDDR4(org, speed);
+}
+template <bool BankGroups>
+inline TableDRAM<BankGroups>* make_spec(const std::string& standard, const std::string& org, const std::string&, TableDRAM<BankGroups>*) {
+    return new TableDRAM<BankGroups>(standard, org);
+}
+
+class DeviceModelBase {
+public:
+    virtual ~DeviceModelBase() {}
+};
+
+/**
+ * Compiled, immutable description of one (cfg, mapping) pair: the DRAM spec, the compiled
+ * address mapping and the per-level mapping scheme used by Memory<T>.
+ */
+template <class T>
+class DeviceModel : public DeviceModelBase {
+public:
+    explicit DeviceModel(const Config& configs);
+    // from a compiled profile, nothing is parsed
+    explicit DeviceModel(const DeviceProfile& profile);
+
+    std::unique_ptr<T> spec;
+    int byte_idx;                 // device-address bits below the mapping (one channel-width transfer)
+    std::vector<int> addr_bits;
+    AddressMapper mapper;         // compiled mapping shared with BitmapTree (DA <-> coordinates, XOR aware)
+    MapScheme mapping_scheme;     // level -> bit -> source address bits, every level present
+
+private:
+    // checks the organization, sets byte_idx and the mapping-derived members from `mapper`
+    void init(int channels, int ranks);
+    void init_scheme();
+
+    static int calc_log2(int64_t val) {
+        int n = 0;
+        while ((val >>= 1))
+            n ++;
+        return n;
+    }
+};
+
+template <class T>
+DeviceModel<T>::DeviceModel(const Config& configs)
+    : spec(make_spec(configs["standard"], configs["org"], configs["speed"], static_cast<T*>(nullptr))),
+      addr_bits(int(T::Level::MAX))
+{
+    init(configs.get_channels(), configs.get_ranks());
+    // the .map file is compiled once into the shared AddressMapper, the per-level
+    // scheme below is derived from its terms
+    mapper = AddressMapper::fromMapFile(configs["mapping"], byte_idx);
+    init_scheme();
+}
+
+template <class T>
+DeviceModel<T>::DeviceModel(const DeviceProfile& profile)
+    : spec(make_spec(profile.standard(), profile.org(), profile.speed(), static_cast<T*>(nullptr))),
+      addr_bits(int(T::Level::MAX))
+{
+    init(profile.header().channels, profile.header().ranks);
+    mapper = profile.mapper();
+    if (mapper.byte_bits != byte_idx)
+        throw std::invalid_argument("Profile mapping does not match the channel width.");
+    init_scheme();
+}
+
+template <class T>
+void DeviceModel<T>::init(int channels, int ranks)
+{
+    // Check and Set channel, rank number
+    spec->set_channel_number(channels);
+    spec->set_rank_number(ranks);
+    // make sure 2^N channels/ranks
+    int *sz = spec->org_entry.count;
+    if (((sz[0] & (sz[0] - 1)) != 0) || ((sz[1] & (sz[1] - 1)) != 0)) {
+        std::cerr << "Make sure 2^N channels/ranks" << std::endl;
+        throw std::invalid_argument("Channels and ranks must be powers of two.");
+    }
+    // the least significant bits of the physical address are not used for addressing (serve as byte index)
+    // (one channel-width transfer, e.g., 16 bytes for LPDDR4 x16 and 8 bytes for a DDR4 channel)
+    byte_idx = calc_log2(spec->channel_width / 8);
+    if ((1 << byte_idx) != spec->channel_width / 8)
+        throw std::invalid_argument("Channel width must be a power-of-two number of bytes.");
+
+    for (unsigned int lev = 0; lev < addr_bits.size(); lev++) {
+        addr_bits[lev] = calc_log2(sz[lev]);
+    }
+}
+
+template <class T>
+void DeviceModel<T>::init_scheme()
+{
+    if (mapper.burst_length)
+        spec->prefetch_size = mapper.burst_length;
+    // a mapped field without a level would be dropped from the scheme, e.g. Bg bits on a flat standard
+    for (int f = 0; f < int(AddressMapper::Field::MAX); f++) {
+        if (mapper.width(AddressMapper::Field(f)) == 0)
+            continue;
+        bool found = false;
+        for (int lvl = 0; lvl < int(T::Level::MAX); lvl++)
+            found |= T::level_str[lvl] == AddressMapper::field_str[f];
+        if (!found)
+            throw std::invalid_argument(std::string("Mapping has ") + AddressMapper::field_str[f] +
+                                        " bits, but the DRAM standard has no such level.");
+    }
+    for (int lvl = 0; lvl < int(T::Level::MAX); lvl++) {
+        MapSchemeEntry& entry = mapping_scheme[lvl];
+        for (int f = 0; f < int(AddressMapper::Field::MAX); f++) {
+            if (T::level_str[lvl] != AddressMapper::field_str[f])
+                continue;
+            const std::vector<std::vector<int>>& terms = mapper.terms(AddressMapper::Field(f));
+            for (unsigned int bit = 0; bit < terms.size(); bit++)
+                for (int source : terms[bit])
+                    entry[bit].push_back(source);
+        }
+    }
+}
+
+/**
+ * Process-wide cache of device models keyed by the (cfg, mapping) paths, and of the standard
+ * named by each cfg. `cfg` may be a compiled .remu profile, `mapping` is then ignored. An entry
+ * is rebuilt when the mtime of either file changes; models are immutable and shared, so
+ * handles stay valid after an entry is replaced or the cache is cleared. Thread-safe.
+ */
+class DeviceModelCache {
+public:
+    static DeviceModelCache& instance();
+
+    template <class T>
+    std::shared_ptr<const DeviceModel<T>> get(const std::string& cfg, const std::string& mapping);
+    // the `standard` of a cfg or profile, which selects T; re-read when the file changes
+    std::string standard(const std::string& cfg);
+
+    void clear();
+    size_t size();
+
+private:
+    struct Stamp {
+        struct timespec cfg;
+        struct timespec mapping;
+        bool operator==(const Stamp& other) const;
+    };
+    struct Entry {
+        Stamp stamp;
+        std::shared_ptr<const DeviceModelBase> model;
+    };
+    struct StandardEntry {
+        struct timespec stamp;
+        std::string standard;
+    };
+    typedef std::pair<std::string, std::string> Key;
+
+    std::mutex lock;
+    std::map<Key, Entry> models;
+    std::map<std::string, StandardEntry> standards;
+
+    // false if either file cannot be stat'ed
+    static bool stamp_of(const std::string& cfg, const std::string& mapping, Stamp& stamp);
+};
+
+template <class T>
+std::shared_ptr<const DeviceModel<T>> DeviceModelCache::get(const std::string& cfg, const std::string& mapping) {
+    Stamp stamp;
+    if (!stamp_of(cfg, mapping, stamp)) {
+        throw std::invalid_argument("Invalid config or mapping file!");
+    }
+    const Key key(cfg, DeviceProfile::is_profile(cfg) ? std::string() : mapping);
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = models.find(key);
+    if (it != models.end() && it->second.stamp == stamp) {
+        auto model = std::dynamic_pointer_cast<const DeviceModel<T>>(it->second.model);
+        if (model)
+            return model;
+    }
+    // built under the lock, so concurrent first users compile the model once
+    std::shared_ptr<const DeviceModel<T>> model;
+    if (DeviceProfile::is_profile(cfg)) {
+        DeviceProfile profile(cfg);
+        if (!profile.has_device()) {
+            throw std::invalid_argument("Profile " + cfg + " has no DRAM configuration.");
+        }
+        model = std::make_shared<const DeviceModel<T>>(profile);
+    } else {
+        Config configs(cfg);
+        if (configs["standard"] == "") {
+            throw std::invalid_argument("DRAM standard should be specified.");
+        }
+        configs.add("mapping", mapping);
+        model = std::make_shared<const DeviceModel<T>>(configs);
+    }
+    models[key] = Entry{stamp, model};
+    return model;
+}
+
+} /*namespace famulator*/
+
+#endif // DEVICE_MODEL_H
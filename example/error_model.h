@@ -0,0 +1,139 @@
+#ifndef ERROR_MODEL_H
+#define ERROR_MODEL_H
+
+#include <map>
+#include <vector>
+#include <random>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <iosfwd>
+
+/**
+ * Many error maps in flat (CSR) form. Map i has the (multiplicity, count) entries
+ * [offsets[i], offsets[i+1]); multiplicities are ascending, as in a std::map<int,int>.
+ */
+struct ErrorMapBatch {
+    std::vector<uint32_t> offsets;    // size() + 1 entries
+    std::vector<int> multiplicity;    // flipped bits per event (1: SEU, 2: 2-bit MBU, ...)
+    std::vector<int> count;           // events of that multiplicity
+
+    size_t size() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+    // map i in the form MemUtils::get_error_Va(_tree) takes
+    std::map<int, int> at(size_t i) const;
+    int total_bits(size_t i) const;
+    // one map per line as "multiplicity:count ", the format of error_counts_<N>.txt
+    void write_text(std::ostream& out) const;
+    // appends every line of an error_counts_<N>.txt (an empty line is an empty map)
+    void read_text(std::istream& in);
+};
+
+/**
+ * Fixed header of a binary error-map file (.emap). It is followed by `maps + 1` uint32
+ * offsets into the entries and `entries` uint32 entries, each a packed
+ * (multiplicity << 24 | count) pair.
+ */
+struct ErrorMapHeader {
+    char magic[8];          // "REMUEMAP"
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t maps;
+    uint64_t entries;
+    uint64_t file_size;
+};
+
+/**
+ * Read-only view of an .emap file, mapped with one mmap. The map of trial i is found
+ * through the offset table without reading the maps before it.
+ */
+class ErrorMapFile {
+public:
+    enum { VERSION = 1 };
+
+    // map and validate the file, throws std::runtime_error
+    explicit ErrorMapFile(const std::string& filename);
+    ~ErrorMapFile();
+    ErrorMapFile(const ErrorMapFile&) = delete;
+    ErrorMapFile& operator=(const ErrorMapFile&) = delete;
+
+    size_t size() const { return head->maps; }
+    // map i (0-based; line i + 1 of the text file), throws std::out_of_range
+    std::map<int, int> at(size_t i) const;
+
+    enum { COUNT_BITS = 24 };
+
+    // writes next to `out` and renames; throws std::invalid_argument, also for a
+    // multiplicity above 255 or a count above 2^24 - 1
+    static void write(const ErrorMapBatch& batch, const std::string& out);
+    // by extension (.emap)
+    static bool is_error_map_file(const std::string& filename);
+    /**
+     * Map at 1-based `line` of an .emap or error_counts text file, an empty map if the line
+     * does not exist. Text files are read up to that line.
+     */
+    static std::map<int, int> load(const std::string& filename, int line);
+
+private:
+    const ErrorMapHeader* head;
+    const uint32_t* offsets;
+    const uint32_t* entries;
+    void* base;
+    size_t length;
+};
+
+/**
+ * Error-map generator (replaces example/get_error.py). One error map is a multiplicity
+ * histogram for one trial: `total` flipped bits split into 2-bit, 3-bit and N-bit MBUs,
+ * the remainder are SEUs.
+ *
+ * The number of MBU events is drawn uniformly between the bounds below, each a fraction
+ * of the total flipped bits; N-bit events get a uniform size in [mbun_min_bits, mbun_max_bits].
+ * A draw that flips more than `total` bits is rejected. The total is either fixed or
+ * Poisson distributed with mean flux x cross-section x exposure time.
+ */
+class ErrorModel {
+public:
+    struct Fractions {
+        double mbu2_min;   // 2-bit MBU events, at least this fraction of the total bits
+        double mbu2_max;
+        double mbu3_max;   // 3-bit MBU events
+        double mbun_max;   // N-bit MBU events
+        int mbun_min_bits;
+        int mbun_max_bits;
+
+        // the get_error.py defaults
+        Fractions() : mbu2_min(0.02), mbu2_max(0.12), mbu3_max(0.02), mbun_max(0.01),
+                      mbun_min_bits(5), mbun_max_bits(7) {}
+    };
+
+    // every map flips exactly total_bits bits (get_error.py --total_bit)
+    static ErrorModel fixed(int total_bits, const Fractions& fractions = Fractions());
+    /**
+     * Beam or field exposure: flux in particles/(cm^2 s), cross_section in cm^2 per
+     * exposed region (per-bit cross-section x exposed bits), seconds of exposure.
+     * The total flipped bits of each map is Poisson distributed around the product.
+     */
+    static ErrorModel flux(double flux, double cross_section, double seconds, const Fractions& fractions = Fractions());
+
+    double expected_bits() const { return mean_bits; }
+    const Fractions& fractions() const { return frac; }
+
+    // one error map
+    std::map<int, int> sample(std::mt19937_64& gen) const;
+    // n error maps in bulk; the same seed gives the same batch
+    ErrorMapBatch sample(size_t n, uint64_t seed) const;
+    void sample(size_t n, std::mt19937_64& gen, ErrorMapBatch& batch) const;
+
+private:
+    ErrorModel(double mean, bool poisson, const Fractions& fractions);
+
+    double mean_bits;
+    bool poisson_total;
+    Fractions frac;
+
+    int draw_total(std::mt19937_64& gen) const;
+    // appends the ascending (multiplicity, count) entries of one map for `total` bits
+    void draw_map(int total, std::mt19937_64& gen, std::vector<int>& multiplicity, std::vector<int>& count) const;
+};
+
+#endif // ERROR_MODEL_H
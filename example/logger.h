@@ -0,0 +1,119 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <iosfwd>
+#include <type_traits>
+#include <cstring>
+
+// levels above this are compiled out of REMU_LOG (0 removes all logging)
+#ifndef REMU_LOG_MAX_LEVEL
+#define REMU_LOG_MAX_LEVEL 5
+#endif
+
+/**
+ * Asynchronous logging for the injection paths.
+ *
+ * A log call copies its format string pointer and up to MAX_ARGS scalar arguments into a
+ * preallocated lock-free ring; a background thread formats the lines and writes them to the
+ * record's stream, flushing once per batch. When the ring is full the caller waits for space,
+ * so no line is lost. A disabled level costs one relaxed load and a branch: REMU_LOG does not
+ * evaluate its arguments then.
+ *
+ * Formats use "{}" for an argument and "{x}" for an integer in hex. String arguments must
+ * outlive the call (literals, static strings), as they are formatted later.
+ *
+ * The drain thread writes to the record's stream (std::cout or, for Warn and Error, std::cerr
+ * when none is given). Call sync() before writing to, or closing, a stream that logged lines
+ * may still go to. The level is read from REMU_LOG_LEVEL (quiet, error, warn, info, debug,
+ * trace) and defaults to info.
+ */
+class Logger {
+public:
+    enum class Level {
+        Quiet,
+        Error,
+        Warn,
+        Info,   // per-injection summaries and the injected addresses in the caller's log file
+        Debug,  // per-fragment and per-address console dumps
+        Trace,
+    };
+
+    enum { MAX_ARGS = 9 };
+
+    static bool enabled(Level level) {
+        return int(level) <= REMU_LOG_MAX_LEVEL && int(level) <= threshold.load(std::memory_order_relaxed);
+    }
+    static void set_level(Level level) { threshold.store(int(level), std::memory_order_relaxed); }
+    static Level level() { return Level(threshold.load(std::memory_order_relaxed)); }
+    // by name (quiet, error, warn, info, debug, trace), throws std::invalid_argument
+    static Level parse_level(const std::string& name);
+
+    template <typename... Args>
+    static void log(Level level, std::ostream* sink, const char* format, Args... args) {
+        static_assert(sizeof...(Args) <= MAX_ARGS, "too many log arguments");
+        Record record;
+        record.format = format;
+        record.sink = sink;
+        record.level = uint8_t(level);
+        record.nargs = 0;
+        pack(record, args...);
+        push(record);
+    }
+
+    // wait until every line logged before the call is written and its stream flushed
+    static void sync();
+    // lines whose writer was interrupted (e.g. by a trial watchdog) and never completed
+    static size_t dropped();
+
+    struct Record {
+        const char* format;
+        std::ostream* sink;
+        uint64_t args[MAX_ARGS];
+        uint8_t types[MAX_ARGS];
+        uint8_t nargs;
+        uint8_t level;
+    };
+    enum ArgType : uint8_t { Int, UInt, Double, Str };
+
+private:
+    static std::atomic<int> threshold;
+    static void push(const Record& record);
+
+    static void pack(Record&) {}
+    template <typename T, typename... Rest>
+    static void pack(Record& record, T value, Rest... rest) {
+        put(record, value);
+        pack(record, rest...);
+    }
+    template <typename T>
+    static typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type put(Record& r, T v) {
+        r.types[r.nargs] = Int;
+        r.args[r.nargs++] = uint64_t(int64_t(v));
+    }
+    template <typename T>
+    static typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type put(Record& r, T v) {
+        r.types[r.nargs] = UInt;
+        r.args[r.nargs++] = uint64_t(v);
+    }
+    template <typename T>
+    static typename std::enable_if<std::is_floating_point<T>::value>::type put(Record& r, T v) {
+        double d = double(v);
+        r.types[r.nargs] = Double;
+        std::memcpy(&r.args[r.nargs++], &d, sizeof(d));
+    }
+    static void put(Record& r, const char* s) {
+        r.types[r.nargs] = Str;
+        r.args[r.nargs++] = uint64_t(uintptr_t(s));
+    }
+};
+
+#define REMU_LOG(level, sink, ...) \
+    do { \
+        if (Logger::enabled(Logger::Level::level)) Logger::log(Logger::Level::level, sink, __VA_ARGS__); \
+    } while (0)
+
+#endif // LOGGER_H
@@ -13,6 +13,12 @@
 #include <opencv2/opencv.hpp>
 #include <bitset>
 #include "mem_utils.h"
+#include "error_model.h"
+#include "trial_guard.h"
+#include "results_store.h"
+#include "logger.h"
+#include "stats.h"
+#include <memory>
 #define CHECK(status) \
     do\
     {\
@@ -27,6 +33,8 @@
 static const int INPUT_H = 224;
 static const int INPUT_W = 224;
 static const int OUTPUT_SIZE = 45;
+// exit status after the trial guard escalated: the driver restarts the process at the next line
+static const int EXIT_RESTART = 75;
 
 const char* INPUT_BLOB_NAME = "data";
 const char* OUTPUT_BLOB_NAME = "prob";
@@ -175,30 +183,13 @@ void readImageInfo(const std::string& filePath, std::vector<std::string>& paths,
 std::map<int, int> loadErrors(const std::string file, int lineidx)
 {
     std::cout << "Loading errors from line " << lineidx << " in file: " << file << std::endl;
-    std::map<int, int> error_count;
-    std::ifstream infile(file);
-
-    if (infile.is_open()) {
-        std::string line;
-        int current_line = 0;
-        while (std::getline(infile, line)) {
-            ++current_line;
-            if (current_line == lineidx) {
-                std::istringstream iss(line);
-                int error, count;
-                char colon;
-                while (iss >> error >> colon >> count) {
-                    error_count[error] = count;
-                }
-                break;  // Stop reading after processing the specified line
-            }
-        }
-        infile.close();
-    } else {
-        std::cerr << "Error: Unable to open error model file" << std::endl;
-        return error_count;
+    // .emap files (remu_errors) are indexed, text files are read up to lineidx
+    try {
+        return ErrorMapFile::load(file, lineidx);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: Unable to open error model file: " << e.what() << std::endl;
+        return std::map<int, int>();
     }
-    return error_count;
 }
 
 
@@ -211,23 +202,32 @@ int main(int argc, char** argv)
     int bitflip;
     int bitidx;
     int device;
-    int lineidx;
+    int first_line;
+    int last_line;
     int time;
     int bias;
-    if (argc == 11 && std::string(argv[1]) == "-d") {
+    size_t span = 0; // bytes of the ROI after bias, 0 for the rest of the engine
+    double deadline = 0; // seconds per trial before it is reported as hung, 0 for none
+    if (argc >= 11 && argc <= 13 && std::string(argv[1]) == "-d") {
         engine_name = std::string(argv[2]);
         images_cfg = std::string(argv[3]);
         labels_dir = std::string(argv[4]);
         bitflip = std::stoi(argv[5]);
         bitidx = std::stoi(argv[6]);
         device = std::stoi(argv[7]);
-        lineidx = std::stoi(argv[8]);
+        // lineidx, or first-last to run several trials in this process
+        std::string lines = argv[8];
+        size_t dash = lines.find('-');
+        first_line = std::stoi(lines.substr(0, dash));
+        last_line = dash == std::string::npos ? first_line : std::stoi(lines.substr(dash + 1));
         time = std::stoi(argv[9]);
         bias = std::stoi(argv[10]);
+        if (argc >= 12) span = std::stoul(argv[11]);
+        if (argc == 13) deadline = std::stod(argv[12]);
         // cudaSetDevice(device);
     } else {
         std::cerr << "arguments not right!" << std::endl;
-        std::cerr << "./resnet50_inference_error -d [.engine] [images_cfg.txt] [labels_dir.txt] [bitflip] [bitidx] [device] [lineidx] [time] [bias]// deserialize plan file and run inference" << std::endl;
+        std::cerr << "./resnet50_inference_error -d [.engine] [images_cfg.txt] [labels_dir.txt] [bitflip] [bitidx] [device] [lineidx|first-last] [time] [bias] ([span] [deadline])// deserialize plan file and run inference" << std::endl;
         return -1;
     }
 
@@ -244,9 +244,11 @@ int main(int argc, char** argv)
     // std::string cfg = "../../libREMU/configs/LPDDR4-config.cfg";
     // std::string mapping = "../../libREMU/mappings/LPDDR4_row_interleaving_16.map";
     std::string tree_mapping = "../../libREMU/configs/lpddr5_jetson_agx_orin.yaml";
-    std::string error_file = "../../example/error_counts_"+std::to_string(bitflip) + ".txt";
+    // converted with: remu_errors -i error_counts_<N>.txt -o error_counts_<N>.emap
+    std::string error_file = "../../example/error_counts_"+std::to_string(bitflip) + ".emap";
+    if (!std::ifstream(error_file).good()) error_file = "../../example/error_counts_"+std::to_string(bitflip) + ".txt";
    
-    std::cout << "mapping: " << mapping << std::endl;
+    std::cout << "mapping: " << tree_mapping << std::endl;
 
     char *trtModelStream{nullptr};
     size_t size{0};
@@ -267,29 +269,6 @@ int main(int argc, char** argv)
 
     uintptr_t Vaddr = reinterpret_cast<uintptr_t>(trtModelStream);
     std::cout << "vaddr: "  << std::hex << Vaddr <<"-"<<std::dec <<size <<" bias: "<<std::dec<<bias<< std::endl;
-    // if lineidx == 0, do DNN inference without any error.
-    if(lineidx){
-        std::map<int, int> errorMap = loadErrors(error_file, lineidx); 
-        size_t dram_capacity_gb=64;
-        MemUtils memUtils(dram_capacity_gb);
-        // Pmem block =  MemUtils::get_block_in_pmems(&memUtils, Vaddr, size, bias);
-        // std::cout << "block_vaddr: " << std::hex << block.s_Vaddr << "-" << std::dec << block.size << std::endl;
-        // MemUtils::get_error_Va(&memUtils, block.s_Vaddr, block.size, logfile, bitflip, bitidx, cfg, mapping, errorMap);
-        MemUtils::get_error_Va_tree(&memUtils, Vaddr+bias, size-bias, logfile, bitflip, bitidx, tree_mapping, errorMap);
-    }
-    
-
-    ICudaEngine* engine = runtime->deserializeCudaEngine(trtModelStream, size);
-    assert(engine != nullptr);
-
-    std::cout<<"Engine deserialized\n";
-    IExecutionContext* context = engine->createExecutionContext();
-    assert(context != nullptr);
-
-    std::cout<<"Context created\n";
-
-    delete[] trtModelStream;
-
 
     std::vector<std::string> image_files;
     std::vector<int> image_targets;
@@ -299,43 +278,137 @@ int main(int argc, char** argv)
     static int idx[1];
 
     auto classes = read_classes(labels_dir);
-    
-    int correct = 0;
 
+    // a crash or hang in deserialization or inference is contained: the trial is reported as
+    // crashed or hung, the flips in the engine stream are reverted and the next line runs.
+    // CUDA and TensorRT cannot be used in a forked child, so after an escalation (SIGABRT, a hang
+    // or too many crashes) the range ends here and the driver restarts at the next line.
+    TrialGuard::Policy policy;
+    policy.fork = false;
+    TrialGuard guard(policy);
+    int restart_line = -1;
+    // one fixed-size record per trial, read back with remu_results
+    std::string resultsFileName = "results_" + std::to_string(bitflip) + "_" + std::to_string(bitidx) + "_" + std::to_string(bias) + "_" + std::to_string(time) + ".rres";
+    ResultsWriter results(resultsFileName);
+    double golden = -1; // accuracy of line 0 when it is in the range
+    std::unique_ptr<MemUtils> memUtils;
+    if (last_line) {
+        size_t dram_capacity_gb=64;
+        memUtils.reset(new MemUtils(dram_capacity_gb));
+        memUtils->guard = &guard;
+    }
 
-    for (size_t j = 0; j < image_files.size(); j++){
-        if(j==100) break; 
-        // std::cout << j << " " << image_files[j] << std::endl;
-        cv::Mat img = cv::imread(image_files[j]);
-        if (img.empty()) continue;
+    for (int lineidx = first_line; lineidx <= last_line; lineidx++) {
+        // the plan does not come back from a forked trial, the correct count does as its status
+        std::vector<Vflip> plan;
+        auto trial_start = std::chrono::steady_clock::now();
+        TrialGuard::Result result = guard.run([&]() {
+            // if lineidx == 0, do DNN inference without any error.
+            if(lineidx){
+                std::map<int, int> errorMap = loadErrors(error_file, lineidx);
+                // Pmem block =  MemUtils::get_block_in_pmems(memUtils.get(), Vaddr, size, bias);
+                // std::cout << "block_vaddr: " << std::hex << block.s_Vaddr << "-" << std::dec << block.size << std::endl;
+                // MemUtils::get_error_Va(memUtils.get(), block.s_Vaddr, block.size, logfile, bitflip, bitidx, cfg, mapping, errorMap);
+                size_t roi = (span && span < size - bias) ? span : size - bias;
+                std::vector<Vmem> errors = MemUtils::get_error_Va_tree(memUtils.get(), Vaddr+bias, roi, logfile, bitflip, bitidx, tree_mapping, errorMap);
+                plan = MemUtils::to_flips(errors, bitidx);
+            }
 
-        cv::Mat pr_img = preprocess_img(img);
-        for (int i = 0; i < INPUT_H * INPUT_W; i++) {
-            data[i] = pr_img.at<cv::Vec3f>(i)[2];
-            data[i + INPUT_H * INPUT_W] = pr_img.at<cv::Vec3f>(i)[1];
-            data[i + 2 * INPUT_H * INPUT_W] = pr_img.at<cv::Vec3f>(i)[0];
-        }
+            ICudaEngine* engine = runtime->deserializeCudaEngine(trtModelStream, size);
+            assert(engine != nullptr);
+
+            std::cout<<"Engine deserialized\n";
+            IExecutionContext* context = engine->createExecutionContext();
+            assert(context != nullptr);
+
+            std::cout<<"Context created\n";
+
+            int correct = 0;
+
+            for (size_t j = 0; j < image_files.size(); j++){
+                if(j==100) break; 
+                // std::cout << j << " " << image_files[j] << std::endl;
+                cv::Mat img = cv::imread(image_files[j]);
+                if (img.empty()) continue;
+
+                cv::Mat pr_img = preprocess_img(img);
+                for (int i = 0; i < INPUT_H * INPUT_W; i++) {
+                    data[i] = pr_img.at<cv::Vec3f>(i)[2];
+                    data[i + INPUT_H * INPUT_W] = pr_img.at<cv::Vec3f>(i)[1];
+                    data[i + 2 * INPUT_H * INPUT_W] = pr_img.at<cv::Vec3f>(i)[0];
+                }
+
+                // Print some values from the preprocessed image
+                // std::cout << "Preprocessed values: " 
+                //           << data[0] << ", " << data[INPUT_H * INPUT_W] << ", " << data[2 * INPUT_H * INPUT_W] 
+                //           << std::endl;
 
-        // Print some values from the preprocessed image
-        // std::cout << "Preprocessed values: " 
-        //           << data[0] << ", " << data[INPUT_H * INPUT_W] << ", " << data[2 * INPUT_H * INPUT_W] 
-        //           << std::endl;
+                doInference(*context, data, prob, idx, 1);
+                // std::cout <<" "<<image_targets[j]<<"-"<<idx[0]<< " " << classes[idx[0]] << " " << prob[0] << std::endl;
+                if (image_targets[j] == idx[0]) correct++;
 
-        doInference(*context, data, prob, idx, 1);
-        // std::cout <<" "<<image_targets[j]<<"-"<<idx[0]<< " " << classes[idx[0]] << " " << prob[0] << std::endl;
-        if (image_targets[j] == idx[0]) correct++;
+            }
 
+            std::cout<<"Inference done\n";
+            // auto end = std::chrono::system_clock::now();
+            // std::cout << "total time: " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << "ms" << std::endl;
+            double accuracy = static_cast<double>(correct) / 100;
+            // the injection log goes to logfile asynchronously, let it finish first
+            Logger::sync();
+            logfile << "Line: " << std::dec << lineidx << ". Bitflip: " << bitflip << ". Accuracy: " << accuracy << std::endl;
+            std::cout << "Line: " << std::dec << lineidx << ". Bitflip: " << bitflip << ". Accuracy: " << accuracy << std::endl;
+            // Destroy the engine
+            delete context;
+            delete engine;
+            return correct;
+        }, deadline);
+        Logger::sync();
+        TrialRecord record;
+        record.seed = 0;
+        record.map_id = uint32_t(lineidx);
+        record.flips = 0;
+        for (const Vflip& f : plan) record.flips += std::bitset<8>(f.mask).count();
+        record.metric = result.outcome == TrialGuard::Outcome::Completed ? result.status / 100.0 : 0;
+        record.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - trial_start).count();
+        if (result.outcome == TrialGuard::Outcome::Hung) {
+            record.outcome = TrialRecord::Outcome::Hung;
+        } else if (result.outcome == TrialGuard::Outcome::Crashed) {
+            record.outcome = TrialRecord::Outcome::Crashed;
+        } else if (lineidx == 0) {
+            golden = record.metric;
+            record.outcome = TrialRecord::Outcome::Masked;
+        } else if (golden >= 0) {
+            record.outcome = ResultsFile::classify(TrialRecord::Outcome::Completed, record.metric, golden);
+        } else {
+            // classified later, e.g. remu_results -g <clean accuracy>
+            record.outcome = TrialRecord::Outcome::Completed;
+        }
+        results.append(record, plan);
+        // on disk before the next trial: a kill by run.py or an escaped crash keeps the finished lines
+        results.flush();
+        if (result.outcome == TrialGuard::Outcome::Hung) {
+            logfile << "Line: " << std::dec << lineidx << ". Bitflip: " << bitflip << ". Hung: " << deadline << " s" << std::endl;
+            std::cout << "Line: " << std::dec << lineidx << ". Bitflip: " << bitflip << ". Hung: " << deadline << " s" << std::endl;
+        } else if (result.outcome == TrialGuard::Outcome::Crashed) {
+            logfile << "Line: " << std::dec << lineidx << ". Bitflip: " << bitflip << ". Crashed: signal " << result.signal << std::endl;
+            std::cout << "Line: " << std::dec << lineidx << ". Bitflip: " << bitflip << ". Crashed: signal " << result.signal << std::endl;
+        }
+        if (guard.escalated()) {
+            if (lineidx < last_line) restart_line = lineidx + 1;
+            break;
+        }
     }
-    
-    std::cout<<"Inference done\n";
-    // auto end = std::chrono::system_clock::now();
-    // std::cout << "total time: " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << "ms" << std::endl;
-    double accuracy = static_cast<double>(correct) / 100;
-    logfile << "Bitflip: " << std::dec << bitflip << ". Accuracy: " << accuracy << std::endl;
-    std::cout << "Bitflip: " << std::dec << bitflip << ". Accuracy: " << accuracy << std::endl;
-    // Destroy the engine
-    delete context;
-    delete engine;
+
+    results.close();
+    // where the campaign's injection time went (trials run in a forked child are not counted)
+    std::ofstream stats("stats_" + std::to_string(bitflip) + "_" + std::to_string(bitidx) + "_" + std::to_string(bias) + "_" + std::to_string(time) + ".json");
+    Stats::snapshot().write_json(stats);
+    stats << std::endl;
+    delete[] trtModelStream;
     delete runtime;
+    if (restart_line >= 0) {
+        std::cout << "Restart: " << restart_line << std::endl;
+        return EXIT_RESTART;
+    }
     return 0;
 }
@@ -0,0 +1,196 @@
+#ifndef RESULTS_STORE_H
+#define RESULTS_STORE_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include "flip_apply.h"
+
+/**
+ * One trial of a campaign, a fixed-size row of the results file.
+ */
+struct TrialRecord {
+    enum class Outcome : uint8_t {
+        Completed, // finished, not compared with a golden run (see ResultsFile::classify)
+        Masked,    // finished with the golden metric
+        SDC,       // finished with a worse metric (silent data corruption)
+        Crashed,
+        Hung,
+        MAX
+    };
+
+    uint64_t seed;     // seed of the error placement, 0 if it was not seeded
+    uint32_t map_id;   // error-map line
+    uint32_t flips;    // bits flipped
+    Outcome outcome;
+    double metric;     // e.g. accuracy
+    double seconds;    // trial wall time
+
+    static const char* outcome_str(Outcome outcome);
+    // by outcome_str name, throws std::invalid_argument
+    static Outcome parse_outcome(const std::string& name);
+};
+
+/**
+ * Results file (.rres) layout:
+ *
+ *   ResultsFileHeader
+ *   block*      ResultsBlockHeader, then the columns of its trials (see ResultsFile::Column)
+ *   index       one ResultsIndexEntry per block
+ *   trailer     ResultsTrailer
+ *
+ * Every column of a block is contiguous and 8-byte aligned, so a reader touches only the
+ * columns it asks for. Blocks are self-describing: a file whose writer died before the index
+ * was written is recovered by walking the blocks.
+ */
+struct ResultsFileHeader {
+    char magic[8];          // "REMURSLT"
+    uint32_t version;
+    uint32_t reserved;
+};
+
+struct ResultsBlockHeader {
+    char magic[4];          // "RBLK"
+    uint32_t trials;
+    uint64_t plan_entries;  // planned flips of all trials of the block
+    uint64_t bytes;         // payload after this header
+};
+
+struct ResultsIndexEntry {
+    uint64_t offset;        // of the block header
+    uint32_t trials;
+    uint32_t reserved;
+    uint64_t plan_entries;
+};
+
+struct ResultsTrailer {
+    uint64_t index_offset;
+    uint64_t blocks;
+    uint64_t trials;
+    char magic[8];          // "REMURIDX"
+};
+
+/**
+ * Append-only writer. Trials are buffered into blocks of `block_trials` and each block goes
+ * out column by column through one buffered stream; close() (or the destructor) appends the
+ * index. Opening an existing file continues it: its index is dropped and rewritten on close.
+ * The file is locked (flock) while a writer has it open.
+ */
+class ResultsWriter {
+public:
+    enum { VERSION = 1 };
+
+    // throws std::runtime_error
+    explicit ResultsWriter(const std::string& filename, uint32_t block_trials = 65536);
+    ~ResultsWriter();
+    ResultsWriter(const ResultsWriter&) = delete;
+    ResultsWriter& operator=(const ResultsWriter&) = delete;
+
+    // the planned flips of the trial are stored with it
+    void append(const TrialRecord& record, const std::vector<Vflip>& plan = std::vector<Vflip>());
+    // write the pending block (the index is written by close)
+    void flush();
+    void close();
+
+    size_t size() const { return trials; }
+
+private:
+    std::string filename;
+    FILE* out;
+    int fd;
+    uint32_t block_trials;
+    uint64_t offset;        // end of the last block
+    size_t trials;
+    std::vector<ResultsIndexEntry> index;
+    std::vector<char> stream_buffer;
+
+    // the pending block, column by column
+    std::vector<uint64_t> seed;
+    std::vector<double> metric;
+    std::vector<double> seconds;
+    std::vector<uint32_t> map_id;
+    std::vector<uint32_t> flips;
+    std::vector<uint32_t> plan_offset;
+    std::vector<uint8_t> outcome;
+    std::vector<uint64_t> plan_vaddr;
+    std::vector<uint64_t> plan_paddr;
+    std::vector<uint8_t> plan_mask;
+
+    void write_block();
+    void write(const void* data, size_t bytes);
+};
+
+/**
+ * Read-only view of a results file, mapped with one mmap.
+ */
+class ResultsFile {
+public:
+    enum class Column {
+        Seed,        // uint64 per trial
+        Metric,      // double per trial
+        Seconds,     // double per trial
+        MapId,       // uint32 per trial
+        Flips,       // uint32 per trial
+        PlanOffset,  // uint32 per trial + 1, into the plan columns of the block
+        Outcome,     // uint8 per trial
+        PlanVaddr,   // uint64 per planned flip
+        PlanPaddr,   // uint64 per planned flip
+        PlanMask,    // uint8 per planned flip
+        MAX
+    };
+
+    // map and validate the file, throws std::runtime_error
+    explicit ResultsFile(const std::string& filename);
+    ~ResultsFile();
+    ResultsFile(const ResultsFile&) = delete;
+    ResultsFile& operator=(const ResultsFile&) = delete;
+
+    size_t size() const { return trials; }
+    size_t blocks() const { return index.size(); }
+    // the index was missing (the writer did not close) and was rebuilt from the blocks
+    bool recovered() const { return rebuilt; }
+
+    // whole columns, in trial order
+    std::vector<uint64_t> seeds() const;
+    std::vector<double> metrics() const;
+    std::vector<double> seconds() const;
+    std::vector<uint32_t> map_ids() const;
+    std::vector<uint32_t> flips() const;
+    std::vector<TrialRecord::Outcome> outcomes() const;
+
+    // throws std::out_of_range
+    TrialRecord at(size_t i) const;
+    std::vector<Vflip> plan(size_t i) const;
+
+    /**
+     * Outcome against a golden metric: a Completed trial is Masked when its metric is at
+     * least golden - tolerance and SDC otherwise; other outcomes are returned as they are.
+     */
+    static TrialRecord::Outcome classify(TrialRecord::Outcome outcome, double metric, double golden, double tolerance = 0);
+
+    // byte offset of a column in a block payload of n trials and m planned flips
+    static size_t column_offset(Column column, size_t n, size_t m);
+
+private:
+    const char* base;
+    size_t length;
+    size_t trials;
+    bool rebuilt;
+    std::vector<ResultsIndexEntry> index;
+    std::vector<size_t> first;   // first trial of every block
+
+    const char* column(size_t block, Column column) const;
+    template <typename T> std::vector<T> gather(Column column) const;
+    // block holding trial i and the trial's position in it
+    size_t locate(size_t i, size_t& row) const;
+
+    friend class ResultsWriter;
+    // blocks of a file without a (valid) index; `end` receives the end of the last whole block
+    static std::vector<ResultsIndexEntry> scan(const char* base, size_t length, uint64_t& end);
+    // index of a closed file, empty if the trailer is missing or invalid
+    static bool read_index(const char* base, size_t length, std::vector<ResultsIndexEntry>& index, uint64_t& end);
+};
+
+#endif // RESULTS_STORE_H
@@ -1,63 +1,405 @@
+import argparse
+import os
 import subprocess
 import re
+import signal
 import time
+import math
+import struct
+import array
+from statistics import NormalDist
 
 
-def run_resnet50(times, t):
-    accuracies = []
-    total_times = []
+class RunningStats:
+    """Welford online mean/variance."""
+    def __init__(self):
+        self.n = 0
+        self.mean = 0.0
+        self.m2 = 0.0
+        self.min = None
+        self.max = None
+
+    def add(self, x):
+        self.n += 1
+        delta = x - self.mean
+        self.mean += delta / self.n
+        self.m2 += delta * (x - self.mean)
+        self.min = x if self.min is None else min(self.min, x)
+        self.max = x if self.max is None else max(self.max, x)
+
+    def variance(self):
+        return self.m2 / (self.n - 1) if self.n > 1 else 0.0
+
+    def half_width(self, z):
+        return z * math.sqrt(self.variance() / self.n) if self.n > 1 else math.inf
+
+
+def wilson(failures, n, z):
+    """Wilson score interval (low, high) of a failure rate."""
+    if n == 0:
+        return 0.0, 1.0
+    p = failures / n
+    denom = 1 + z * z / n
+    center = (p + z * z / (2 * n)) / denom
+    half = z * math.sqrt(p * (1 - p) / n + z * z / (4 * n * n)) / denom
+    return max(0.0, center - half), min(1.0, center + half)
+
+
+def error_maps_file(total_bit):
+    """The error maps the example reads: the indexed .emap when it exists, the text file otherwise."""
+    emap = f'../error_counts_{total_bit}.emap'
+    return emap if os.path.exists(emap) else f'../error_counts_{total_bit}.txt'
+
+
+EMAP_HEADER = struct.Struct('=8sIIQQQ')  # ErrorMapHeader: magic, version, reserved, maps, entries, file_size
+EMAP_COUNT_BITS = 24  # entries are multiplicity << 24 | count
+
+
+def load_error_classes(error_file):
+    """Multiplicity class (largest flipped-bit count) of every map of an .emap or error_counts file."""
+    classes = []
+    if error_file.endswith('.emap'):
+        with open(error_file, 'rb') as f:
+            data = f.read()
+        magic, version, _, maps, entries, file_size = EMAP_HEADER.unpack_from(data)
+        if magic != b'REMUEMAP' or version != 1 or file_size != len(data):
+            raise ValueError(f'{error_file}: not a version 1 error-map file')
+        table = array.array('I', data[EMAP_HEADER.size:EMAP_HEADER.size + 4 * (maps + 1 + entries)])
+        offsets, packed = table[:maps + 1], table[maps + 1:]
+        mask = (1 << EMAP_COUNT_BITS) - 1
+        for i in range(maps):
+            entry = packed[offsets[i]:offsets[i + 1]]
+            classes.append(max((e >> EMAP_COUNT_BITS for e in entry if e & mask), default=0))
+        return classes
+    with open(error_file) as f:
+        for line in f:
+            pairs = [p.split(':') for p in line.split()]
+            classes.append(max((int(m) for m, c in pairs if int(c) > 0), default=0))
+    return classes
+
+
+def class_name(multiplicity):
+    return {0: 'none', 1: 'SEU', 2: '2-bit MBU', 3: '3-bit MBU'}.get(multiplicity, 'N-bit MBU')
+
+
+ENGINE = 'xxx.engine'  # xxx.engine: change your own TensorRT engine file
+
+
+def deadline_of(golden, factor, minimum):
+    """Per-trial deadline from the golden-run latency."""
+    return max(minimum, factor * golden)
+
+
+EXIT_RESTART = 75  # the example's trial guard escalated, restart at the next line
+
+
+def run_process(log, command, timeout):
+    """Run one example process; returns (stdout, returncode, timed out, seconds)."""
+    print(f'Running: {command}')
+    start_time = time.time()
+
+    # own session, so the shell, sudo and the example are killed as one group
+    proc = subprocess.Popen(command, shell=True, stdout=subprocess.PIPE, stderr=subprocess.PIPE, universal_newlines=True, start_new_session=True)
+    timed_out = False
+    try:
+        stdout, stderr = proc.communicate(timeout=timeout)
+    except subprocess.TimeoutExpired:
+        timed_out = True
+        # sudo relays SIGTERM to the example; SIGKILL takes whatever is left
+        for sig, grace in ((signal.SIGTERM, 5), (signal.SIGKILL, None)):
+            try:
+                os.killpg(proc.pid, sig)
+            except (ProcessLookupError, PermissionError):
+                pass
+            try:
+                stdout, stderr = proc.communicate(timeout=grace)
+                break
+            except subprocess.TimeoutExpired:
+                continue
+
+    elapsed_time = time.time() - start_time
+    log.write(f'{command}: Elapsed time {elapsed_time} seconds\n')
+    log.write(stdout)
+    log.write(stderr)
+    log.flush()
+    return stdout, proc.returncode, timed_out, elapsed_time
+
+
+def signaled(returncode):
+    """
+    The process was killed by a signal: a negative return code, or 128 + signal when the shell
+    reports the example's death. Other non-zero codes (e.g. 255 for the example's bad arguments
+    or failed setup) are harness errors, not crashes.
+    """
+    return returncode < 0 or 128 < returncode < 128 + 65
+
+
+def run_lines(log, total_bit, flip_bit, first, last, t, bias, span=None, deadline=None):
+    """
+    Inference runs with the errors of lines `first` to `last`, as few processes as possible;
+    returns ({line: (accuracy or None, outcome)}, seconds).
+    outcome is 'crash' for a trial contained by the example's trial guard or a process killed by a
+    signal in it, 'hang' for a trial past `deadline` seconds, None otherwise. Lines without a
+    result (e.g. after a harness error) are missing.
+    The example enforces the deadline per trial; the process is also killed after one more
+    deadline than it has trials (which covers its startup), so a hang outside the guarded trials
+    cannot stall the campaign. A process that ends early is resumed after its last finished line:
+    at the next line after an escalation of its trial guard, past the line it died in otherwise.
+    """
+    results = {}
+    elapsed = 0
+    while first <= last:
+        command = f'sudo ./resnet50_inference_error -d {ENGINE} ../images_cfg.txt  ../nwpu_labels.txt {total_bit} {flip_bit} 0 {first}-{last} {t} {bias}'
+        if span is not None or deadline is not None:
+            command += f' {span or 0}'
+        if deadline is not None:
+            command += f' {deadline:.3f}'
+        stdout, returncode, timed_out, seconds = run_process(log, command, None if deadline is None else (last - first + 2) * deadline)
+        elapsed += seconds
+
+        done = first - 1
+        for m in re.finditer(r'Line: (\d+)\. Bitflip: \d+\. (?:Accuracy: ([0-9.]+)|(Hung):|(Crashed): signal)', stdout):
+            line = int(m.group(1))
+            if line < first or line > last:
+                continue
+            accuracy, outcome = results.get(line, (None, None))
+            if m.group(2) is not None:
+                accuracy = float(m.group(2))
+            else:
+                # a trial can print its accuracy and crash afterwards
+                outcome = 'hang' if m.group(3) else 'crash'
+            results[line] = (accuracy, outcome)
+            done = max(done, line)
+        if done >= last:
+            break
+        if returncode == EXIT_RESTART and done >= first:
+            first = done + 1
+            continue
+        # the process ended inside line done + 1
+        if timed_out:
+            results[done + 1] = (None, 'hang')
+        elif signaled(returncode):
+            results[done + 1] = (None, 'crash')
+        else:
+            # the harness failed, not the trial: the rest of the range has no result
+            message = f'Harness error: exit status {returncode} in lines {done + 1}-{last}'
+            print(message)
+            log.write(message + '\n')
+            break
+        first = done + 2
+    return results, elapsed
+
+
+def run_resnet50(times, t, halfwidth=0.05, acc_halfwidth=0.005, confidence=0.95, min_trials=30, tolerance=0.0, hang_factor=5.0, min_deadline=10.0, chunk=100):
+    accuracies = RunningStats()
     total_accumulated_time = 0
     total_bit=100
     flip_bit=7
     bias=13000 # the sensitive area.
+    z = NormalDist().inv_cdf((1 + confidence) / 2)
+    # a trial fails when its accuracy drops more than `tolerance` below the clean run (line 0)
+    baseline = None
+    failures = 0
+    crashes = 0
+    hangs = 0
+    deadline = None  # armed once the clean run has given the golden latency
+    by_class = {}  # multiplicity class -> [failures, trials]
+    classes = load_error_classes(error_maps_file(total_bit))
+    stopped = None
+    executed = 0  # last line that was run, the ranges may run past the stopping line
     log_file="block_{0}_{1}_int8_clean_{2}_{3}.txt".format(total_bit, flip_bit, bias, t)
+    pending = {}  # results of the current range of lines
+
+    def range_size():
+        """Lines of the next range: `chunk`, fewer once the half-widths are near their targets."""
+        n = accuracies.n + crashes + hangs
+        if n < min_trials:
+            return chunk
+        # a half-width shrinks with 1/sqrt(n), so n * (current / target)^2 trials meet the target
+        low, high = wilson(failures, n, z)
+        ratio = max(((high - low) / 2 / halfwidth) ** 2, (accuracies.half_width(z) / acc_halfwidth) ** 2)
+        if math.isinf(ratio):
+            return chunk
+        return max(1, min(chunk, math.ceil(n * ratio) - n))
+
     with open(log_file, 'w') as log:
         for i in range(times+1):
-            # xxx.engine: change your own TensorRT engine file
-            command = f'sudo ./resnet50_inference_error -d xxx.engine ../images_cfg.txt  ../nwpu_labels.txt {total_bit} {flip_bit} 0 {i} {t} {bias}'
-            print(f'Running: {command}')
-            start_time = time.time()
-
-            result = subprocess.run(command, shell=True, stdout=subprocess.PIPE, stderr=subprocess.PIPE, universal_newlines=True)
-
-            end_time = time.time()
-            elapsed_time = end_time - start_time
-            total_accumulated_time += elapsed_time
-
-            # Write the output and error to log file
-            print(f'Run {i+1}: Elapsed time {elapsed_time} seconds\n')
-            log.write(f'Run {i+1}: Elapsed time {elapsed_time} seconds\n')
-            log.write(result.stdout)
-            log.write(result.stderr)
+            if i not in pending:
+                # the clean run alone, its latency gives the deadline of the others
+                last = 0 if i == 0 else min(i + range_size() - 1, times)
+                pending, elapsed_time = run_lines(log, total_bit, flip_bit, i, last, t, bias, deadline=deadline)
+                executed = max(executed, max(pending, default=i - 1))
+                total_accumulated_time += elapsed_time
+                print(f'Lines {i}-{last}: Elapsed time {elapsed_time} seconds\n')
+            accuracy, outcome = pending.pop(i, (None, None))
+            if accuracy is None and not (outcome and i > 0):
+                print("No result\n-----\n")
+                continue
+            print(f'---------------------------------------\n')
+            print(outcome or accuracy)
+            if i == 0:
+                baseline = accuracy
+                deadline = deadline_of(elapsed_time, hang_factor, min_deadline)
+                continue
+            # crashes and hangs are failures without an accuracy
+            if outcome:
+                crashes += outcome == 'crash'
+                hangs += outcome == 'hang'
+                failed = True
+            else:
+                accuracies.add(accuracy)
+                failed = baseline is not None and accuracy < baseline - tolerance
+            failures += failed
+            cls = class_name(classes[i - 1]) if i - 1 < len(classes) else 'unknown'
+            counts = by_class.setdefault(cls, [0, 0])
+            counts[0] += failed
+            counts[1] += 1
+
+            # sequential stopping on the failure-rate and mean-accuracy half-widths
+            low, high = wilson(failures, accuracies.n + crashes + hangs, z)
+            if accuracies.n + crashes + hangs >= min_trials and (high - low) / 2 <= halfwidth and accuracies.half_width(z) <= acc_halfwidth:
+                stopped = i
+                break
+
+        n = accuracies.n + crashes + hangs
+        print(f'Successed : {n + (baseline is not None)}')
+        log.write(f'Successed : {n + (baseline is not None)} in {times+1}\n')
+        print(f'Total accumulated time: {total_accumulated_time} seconds\n')
+        log.write(f'Total accumulated time: {total_accumulated_time} seconds\n')
+        if stopped is not None:
+            # the lines of the last range past `stopped` were run, they are not saved
+            saved = f'Converged after {stopped} of {times} trials, {executed} run ({times - executed} saved, {100.0 * (times - executed) / times:.1f}%)'
+        else:
+            saved = f'Budget of {times} trials exhausted before the target half-width'
+        print(saved)
+        log.write(saved + '\n')
+        log.flush()
+        if n:
+            low, high = wilson(failures, n, z)
+            summary = [
+                f'Clean Accuracy: {baseline}',
+                f'Average Accuracy: {accuracies.mean} +/- {accuracies.half_width(z)} ({confidence:.0%} CI, std {math.sqrt(accuracies.variance())})',
+                f'Minimum Accuracy: {accuracies.min}',
+                f'Maximum Accuracy: {accuracies.max}',
+                f'Failure rate: {failures}/{n} = {failures / n:.4f} [{low:.4f}, {high:.4f}]',
+                f'SDC: {failures - crashes - hangs}/{n} = {(failures - crashes - hangs) / n:.4f}',
+                f'Crashes: {crashes}/{n} = {crashes / n:.4f}',
+                f'Hangs: {hangs}/{n} = {hangs / n:.4f} (deadline {deadline} s)',
+            ]
+            for cls, (f, c) in sorted(by_class.items()):
+                low, high = wilson(f, c, z)
+                summary.append(f'  {cls}: {f}/{c} = {f / c:.4f} [{low:.4f}, {high:.4f}]')
+            for line in summary:
+                print(line)
+                log.write(line + '\n')
             log.flush()
 
-            # Extract accuracy from the output
-            accuracy_match = re.search(r'Accuracy: ([0-9.]+)', result.stdout)
-            if accuracy_match:
-                accuracy = float(accuracy_match.group(1))
-                accuracies.append(accuracy)
-                print(f'---------------------------------------\n')
-                print(accuracy)
+
+def search_regions(t, roi_size, regions=8, batch=10, budget=400, min_span=65536, confidence=0.95, tolerance=0.0, halfwidth=0.1, hang_factor=5.0, min_deadline=10.0):
+    """
+    Adaptive sensitive-region search over the engine bytes [0, roi_size).
+
+    The ROI is split into `regions` ranges with `batch` trials each. Then the range with the
+    highest Wilson upper bound on its failure rate is refined: it is bisected (each half gets a
+    new batch) while it is wider than `min_span`, otherwise it gets another batch until its
+    interval half-width is at most `halfwidth`. Ranges that are clearly robust are never
+    refined, so the trials go to high or uncertain failure rates.
+    """
+    total_bit=100
+    flip_bit=7
+    z = NormalDist().inv_cdf((1 + confidence) / 2)
+    lines = len(load_error_classes(error_maps_file(total_bit)))
+    next_line = [0]
+    used = [0]
+    log_file="search_{0}_{1}_{2}.txt".format(total_bit, flip_bit, t)
+    with open(log_file, 'w') as log:
+        clean, golden = run_lines(log, total_bit, flip_bit, 0, 0, t, 0)
+        baseline = clean.get(0, (None, None))[0]
+        deadline = deadline_of(golden, hang_factor, min_deadline)
+        if baseline is None:
+            print("No clean result\n-----\n")
+            return []
+
+        def run_batch(region):
+            remaining = batch
+            while remaining:
+                # cycle through the error maps so every range sees different ones
+                first = next_line[0] % lines + 1
+                last = min(first + remaining - 1, lines)
+                results, _ = run_lines(log, total_bit, flip_bit, first, last, t, region['start'], region['span'], deadline)
+                next_line[0] = last
+                remaining -= last - first + 1
+                for line in range(first, last + 1):
+                    accuracy, outcome = results.get(line, (None, None))
+                    used[0] += 1
+                    if accuracy is None and not outcome:
+                        continue
+                    region['n'] += 1
+                    region['fail'] += bool(outcome) or accuracy < baseline - tolerance
+
+        def upper(region):
+            return wilson(region['fail'], region['n'], z)[1]
+
+        def resolved(region):
+            low, high = wilson(region['fail'], region['n'], z)
+            return region['span'] < 2 * min_span and (high - low) / 2 <= halfwidth
+
+        step = -(-roi_size // regions)
+        leaves = [{'start': s, 'span': min(step, roi_size - s), 'fail': 0, 'n': 0} for s in range(0, roi_size, step)]
+        for region in leaves:
+            run_batch(region)
+        while used[0] + batch <= budget:
+            open_leaves = [r for r in leaves if not resolved(r)]
+            if not open_leaves:
+                break
+            region = max(open_leaves, key=upper)
+            if region['span'] >= 2 * min_span:
+                half = region['span'] // 2
+                children = [{'start': region['start'], 'span': half, 'fail': 0, 'n': 0},
+                            {'start': region['start'] + half, 'span': region['span'] - half, 'fail': 0, 'n': 0}]
+                leaves.remove(region)
+                leaves.extend(children)
+                for child in children:
+                    if used[0] + batch > budget:
+                        break
+                    run_batch(child)
             else:
-                print("No result\n-----\n")
+                run_batch(region)
 
-        print(f'Successed : {len(accuracies)}')
-        log.write(f'Successed : {len(accuracies)} in {times+1}\n')
-        print(f'1000 tests 500 imgs\n Total accumulated time: {total_accumulated_time} seconds\n')
-        log.write(f'1000 tests 500 imgs\nTotal accumulated time: {total_accumulated_time} seconds\n')
+        # ranked by the lower bound, so a range is reported as sensitive only with evidence
+        ranked = sorted(leaves, key=lambda r: wilson(r['fail'], r['n'], z)[0], reverse=True)
+        uniform = -(-roi_size // min_span) * batch
+        summary = [f'Clean Accuracy: {baseline}',
+                   f'{used[0]} trials; a uniform sweep at {min_span} bytes needs {uniform} ({100.0 * used[0] / uniform:.1f}%)']
+        for r in ranked:
+            low, high = wilson(r['fail'], r['n'], z)
+            rate = r['fail'] / r['n'] if r['n'] else 0.0
+            summary.append(f'  [{r["start"]}, {r["start"] + r["span"]}): {r["fail"]}/{r["n"]} = {rate:.4f} [{low:.4f}, {high:.4f}]')
+        for line in summary:
+            print(line)
+            log.write(line + '\n')
         log.flush()
-        if accuracies:
-            avg_accuracy = sum(accuracies) / len(accuracies)
-            min_accuracy = min(accuracies)
-            max_accuracy = max(accuracies)
-            print(f'Average Accuracy: {avg_accuracy}')
-            print(f'Minimum Accuracy: {min_accuracy}')
-            print(f'Maximum Accuracy: {max_accuracy}')
-            
-            log.write(f'Average Accuracy: {avg_accuracy}\n')
-            log.write(f'Minimum Accuracy: {min_accuracy}\n')
-            log.write(f'Maximum Accuracy: {max_accuracy}\n')
-            log.flush()
+        return ranked
+
+
 if __name__ == '__main__':
-    # run 10 times
-    run_resnet50(10, 1)
+    parser = argparse.ArgumentParser(description='Run an error-injection campaign with sequential stopping')
+    parser.add_argument('--trials', type=int, default=1000, help='trial budget')
+    parser.add_argument('--time', type=int, default=1, help='campaign index (log file name and example time argument)')
+    parser.add_argument('--halfwidth', type=float, default=0.05, help='target half-width of the failure-rate interval')
+    parser.add_argument('--acc-halfwidth', type=float, default=0.005, help='target half-width of the mean-accuracy interval')
+    parser.add_argument('--confidence', type=float, default=0.95)
+    parser.add_argument('--min-trials', type=int, default=30, help='trials before stopping is considered')
+    parser.add_argument('--tolerance', type=float, default=0.0, help='accuracy drop below the clean run that counts as a failure')
+    parser.add_argument('--hang-factor', type=float, default=5.0, help='per-trial deadline as a multiple of the clean-run latency')
+    parser.add_argument('--min-deadline', type=float, default=10.0, help='smallest per-trial deadline in seconds')
+    parser.add_argument('--chunk', type=int, default=100, help='trials per example process')
+    parser.add_argument('--search', action='store_true', help='rank sensitive byte ranges of the engine instead of a fixed-bias campaign')
+    parser.add_argument('--regions', type=int, default=8, help='search: initial ranges')
+    parser.add_argument('--batch', type=int, default=10, help='search: trials per range and refinement step')
+    parser.add_argument('--min-span', type=int, default=65536, help='search: smallest range in bytes')
+    args = parser.parse_args()
+    if args.search:
+        search_regions(args.time, os.path.getsize(ENGINE), args.regions, args.batch, args.trials, args.min_span, args.confidence, args.tolerance, args.halfwidth, args.hang_factor, args.min_deadline)
+    else:
+        run_resnet50(args.trials, args.time, args.halfwidth, args.acc_halfwidth, args.confidence, args.min_trials, args.tolerance, args.hang_factor, args.min_deadline, args.chunk)
@@ -0,0 +1,90 @@
+#ifndef __DRAM_STANDARD_H
+#define __DRAM_STANDARD_H
+
+#include <string>
+
+namespace famulator
+{
+
+/**
+ * Registry of DRAM standards. Each standard is one table entry (organization table,
+ * channel width, prefetch) and is bound at load time to a spec class:
+ *  - LPDDR4:  the full LPDDR4 spec (org/speed tables in LPDDR4.h)
+ *  - Flat:    TableDRAM<false>, levels Ch/Ra/Ba/Ro/Co
+ *  - Grouped: TableDRAM<true>,  levels Ch/Ra/Bg/Ba/Ro/Co
+ * ErrorBitmap is instantiated once per family, so the choice costs nothing per call.
+ */
+enum class DRAMFamily : int {
+    LPDDR4, Flat, Grouped, MAX
+};
+
+struct DRAMOrg {
+    const char* name;   // org name without the "<standard>_" prefix, e.g. "4Gb_x8"
+    int size;           // Mb
+    int dq;
+    int count[6];       // Ch, Ra, Bg, Ba, Ro, Co (columns in DQ-wide words, Bg is 0 for flat parts)
+};
+
+struct DRAMStandardInfo {
+    const char* name;
+    DRAMFamily family;
+    int channel_width;
+    int prefetch_size;
+    const DRAMOrg* orgs;
+    int org_count;
+};
+
+// nullptr if the standard is not registered
+const DRAMStandardInfo* find_dram_standard(const std::string& name);
+// org strings are "<standard>_<org>" as in configs/*.cfg; nullptr if unknown
+const DRAMOrg* find_dram_org(const DRAMStandardInfo& standard, const std::string& org);
+
+template <bool BankGroups>
+struct DRAMLevels {
+    enum class Level : int
+    {
+        Channel, Rank, Bank, Row, Column, MAX
+    };
+};
+
+template <>
+struct DRAMLevels<true> {
+    enum class Level : int
+    {
+        Channel, Rank, BankGroup, Bank, Row, Column, MAX
+    };
+};
+
+/**
+ * Spec of a registered standard, built from its organization table. Only the parts
+ * Memory<T> uses (levels, counts, widths) are modelled, there is no timing.
+ */
+template <bool BankGroups>
+class TableDRAM
+{
+public:
+    typedef typename DRAMLevels<BankGroups>::Level Level;
+    static std::string level_str [int(Level::MAX)];
+
+    TableDRAM(const std::string& standard, const std::string& org);
+
+    std::string standard_name;
+    struct OrgEntry {
+        int size;
+        int dq;
+        int count[int(Level::MAX)];
+    } org_entry;
+
+    int prefetch_size;
+    int channel_width;
+
+    void set_channel_number(int channel) { org_entry.count[int(Level::Channel)] = channel; }
+    void set_rank_number(int rank) { org_entry.count[int(Level::Rank)] = rank; }
+};
+
+typedef TableDRAM<false> FlatDRAM;
+typedef TableDRAM<true> GroupedDRAM;
+
+} /*namespace famulator*/
+
+#endif /*__DRAM_STANDARD_H*/
@@ -0,0 +1,534 @@
+#include "address_mapper.h"
+#include "device_profile.h"
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <cassert>
+#include <yaml-cpp/yaml.h>
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define REMU_HAVE_BMI2_KERNEL 1
+#endif
+#if defined(__aarch64__) && defined(__ARM_NEON) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define REMU_HAVE_NEON_KERNEL 1
+#endif
+#ifdef REMU_HAVE_NEON_KERNEL
+#include <arm_neon.h>
+#endif
+
+const char* AddressMapper::field_str[int(Field::MAX)] = {"Ch", "Ra", "Bg", "Ba", "Ro", "Co"};
+
+static const char* yaml_field_str[int(AddressMapper::Field::MAX)] = {
+    "channel", "rank", "bankgroup", "bank", "row", "column"
+};
+
+static void add_term(std::vector<std::vector<int>>& bits, int target, int source) {
+    if (target < 0 || source < 0 || source >= 64) {
+        throw std::invalid_argument("Mapping bit out of range");
+    }
+    if (static_cast<int>(bits.size()) <= target) bits.resize(target + 1);
+    bits[target].push_back(source);
+}
+
+AddressMapper AddressMapper::fromMapFile(const std::string& filename, int byte_bits) {
+    std::ifstream file(filename);
+    if (!file.good()) {
+        throw std::invalid_argument("Invalid mapping or bad mapping file!");
+    }
+    AddressMapper mapper;
+    mapper.byte_bits = byte_bits;
+    // possible line types are:
+    // 0. Empty line
+    // 1. Direct bit assignment   : component N   = x
+    // 2. Direct range assignment : component N:M = x:y
+    // 3. XOR bit assignment      : component N   = x y z ...
+    // 4. Comment line            : # comment here
+    std::string line;
+    const char delim[] = " \t";
+    while (std::getline(file, line)) {
+        int capture_flags = 0;
+        int level = -1;
+        int target_bit = -1, target_bit2 = -1;
+        bool is_range = false;
+        size_t pos = 0;
+        while (true) { // process next word
+            size_t start = line.find_first_not_of(delim, pos);
+            if (start == std::string::npos) // no more words
+                break;
+            size_t end = line.find_first_of(delim, start);
+            std::string word = line.substr(start, end - start);
+            pos = end;
+
+            if (word[0] == '#') // starting a comment
+                break;
+            if (word == "Burst_length") {
+                start = line.find_first_not_of(delim, end);
+                if (start != std::string::npos) {
+                    mapper.burst_length = std::stoi(line.substr(start, line.find_first_of(delim, start) - start));
+                }
+                break;
+            }
+            size_t col_index;
+            switch (capture_flags) {
+                case 0: // capturing the component name
+                    for (int i = 0; i < int(Field::MAX); i++) {
+                        if (word.find(field_str[i]) != std::string::npos) {
+                            level = i;
+                            capture_flags = 1;
+                        }
+                    }
+                    break;
+                case 1: // capturing target bit(s)
+                    col_index = word.find(':');
+                    if (col_index != std::string::npos) {
+                        target_bit2 = std::stoi(word.substr(col_index + 1));
+                        word = word.substr(0, col_index);
+                        is_range = true;
+                    }
+                    target_bit = std::stoi(word);
+                    capture_flags++;
+                    break;
+                case 2: // this should be the delimiter
+                    assert(word.find('=') != std::string::npos);
+                    capture_flags++;
+                    break;
+                case 3:
+                    if (is_range) {
+                        col_index = word.find(':');
+                        int source_bit = std::stoi(word.substr(0, col_index));
+                        int source_bit2 = std::stoi(word.substr(col_index + 1));
+                        if (source_bit2 - source_bit != target_bit2 - target_bit) {
+                            throw std::invalid_argument("Mapping range widths differ: " + line);
+                        }
+                        int source_min = std::min(source_bit, source_bit2);
+                        int target_min = std::min(target_bit, target_bit2);
+                        int target_max = std::max(target_bit, target_bit2);
+                        for (; target_min <= target_max; target_min++, source_min++) {
+                            add_term(mapper.field_terms[level], target_min, source_min);
+                        }
+                    } else { // one or more XOR-ed sources
+                        add_term(mapper.field_terms[level], target_bit, std::stoi(word));
+                    }
+            }
+            if (end == std::string::npos) // this is the last word
+                break;
+        }
+    }
+    mapper.compile();
+    return mapper;
+}
+
+AddressMapper AddressMapper::fromYaml(const std::string& filename) {
+    AddressMapper mapper;
+    try {
+        YAML::Node root = YAML::LoadFile(filename);
+        YAML::Node dq = root["dram"]["interface"]["DQ"];
+        mapper.byte_bits = dq ? dq.as<int>() : 0;
+        YAML::Node mappingNode = root["mapping"]["bit_mapping"];
+        for (int f = 0; f < int(Field::MAX); f++) {
+            YAML::Node bits = mappingNode[yaml_field_str[f]];
+            if (!bits) continue;
+            for (size_t i = 0; i < bits.size(); i++) {
+                if (bits[i].IsSequence()) {
+                    for (size_t j = 0; j < bits[i].size(); j++) {
+                        add_term(mapper.field_terms[f], int(i), bits[i][j].as<int>());
+                    }
+                } else {
+                    add_term(mapper.field_terms[f], int(i), bits[i].as<int>());
+                }
+            }
+        }
+    }
+    catch (const YAML::Exception& e) {
+        std::cerr << "Error reading YAML file: " << e.what() << std::endl;
+        throw;
+    }
+    mapper.compile();
+    return mapper;
+}
+
+AddressMapper AddressMapper::load(const std::string& filename, int map_byte_bits) {
+    size_t dot = filename.rfind('.');
+    std::string ext = dot == std::string::npos ? "" : filename.substr(dot);
+    if (ext == ".yaml" || ext == ".yml") return fromYaml(filename);
+    if (DeviceProfile::is_profile(filename)) return DeviceProfile(filename).mapper();
+    return fromMapFile(filename, map_byte_bits);
+}
+
+AddressMapper AddressMapper::fromCompiled(const std::vector<std::vector<int>> terms[], int byte_bits, int burst_length,
+                                          const uint64_t* fwd, size_t fwd_count, const uint64_t* inv) {
+    AddressMapper mapper;
+    mapper.byte_bits = byte_bits;
+    mapper.burst_length = burst_length;
+    mapper.packed_bits = 0;
+    for (int f = 0; f < int(Field::MAX); f++) {
+        mapper.field_terms[f] = terms[f];
+        mapper.field_offset[f] = mapper.packed_bits;
+        for (const auto& sources : terms[f]) {
+            uint64_t mask = 0;
+            for (int source : sources) {
+                if (source < 0 || source > 63) throw std::invalid_argument("Compiled mapping has an address bit out of range");
+                mask ^= (1ULL << source);
+            }
+            mapper.fwd_rows.push_back(mask);
+        }
+        mapper.packed_bits += int(terms[f].size());
+    }
+    if (mapper.fwd_rows.size() != fwd_count || !std::equal(mapper.fwd_rows.begin(), mapper.fwd_rows.end(), fwd)) {
+        throw std::invalid_argument("Compiled mapping does not match its terms");
+    }
+    mapper.inv_rows.assign(inv, inv + 64);
+    mapper.compile_kernels();
+    return mapper;
+}
+
+bool AddressMapper::has_xor() const {
+    for (int f = 0; f < int(Field::MAX); f++) {
+        for (const auto& sources : field_terms[f]) {
+            if (sources.size() > 1) return true;
+        }
+    }
+    return false;
+}
+
+void AddressMapper::compile() {
+    packed_bits = 0;
+    fwd_rows.clear();
+    for (int f = 0; f < int(Field::MAX); f++) {
+        field_offset[f] = packed_bits;
+        for (size_t bit = 0; bit < field_terms[f].size(); bit++) {
+            if (field_terms[f][bit].empty()) {
+                throw std::invalid_argument(std::string("Mapping has no source for ") + field_str[f] + " bit " + std::to_string(bit));
+            }
+            uint64_t mask = 0;
+            for (int source : field_terms[f][bit]) mask ^= (1ULL << source);
+            fwd_rows.push_back(mask);
+        }
+        packed_bits += int(field_terms[f].size());
+        if (field_terms[f].size() > 32) {
+            throw std::invalid_argument(std::string("Mapping field wider than 32 bits: ") + field_str[f]);
+        }
+    }
+    if (packed_bits > 64) {
+        throw std::invalid_argument("Mapping has more than 64 coordinate bits");
+    }
+
+    // the line-address bits the mapping depends on
+    uint64_t used = 0;
+    for (uint64_t row : fwd_rows) used |= row;
+    std::vector<int> used_bits;
+    for (int b = 0; b < 64; b++) {
+        if (used & (1ULL << b)) used_bits.push_back(b);
+    }
+    if (used_bits.size() != static_cast<size_t>(packed_bits)) {
+        throw std::invalid_argument("Mapping is not invertible: " + std::to_string(packed_bits) + " coordinate bits from "
+                                    + std::to_string(used_bits.size()) + " address bits");
+    }
+
+    // Gauss-Jordan elimination of [M | I] over GF(2), M restricted to the used address bits
+    const int n = packed_bits;
+    std::vector<uint64_t> a(n), b(n);
+    for (int k = 0; k < n; k++) {
+        a[k] = 0;
+        for (int i = 0; i < n; i++) {
+            if (fwd_rows[k] & (1ULL << used_bits[i])) a[k] |= (1ULL << i);
+        }
+        b[k] = 1ULL << k;
+    }
+    for (int c = 0; c < n; c++) {
+        int pivot = c;
+        while (pivot < n && !(a[pivot] & (1ULL << c))) pivot++;
+        if (pivot == n) {
+            throw std::invalid_argument("Mapping is not invertible: XOR terms are linearly dependent");
+        }
+        std::swap(a[c], a[pivot]);
+        std::swap(b[c], b[pivot]);
+        for (int r = 0; r < n; r++) {
+            if (r != c && (a[r] & (1ULL << c))) {
+                a[r] ^= a[c];
+                b[r] ^= b[c];
+            }
+        }
+    }
+    inv_rows.assign(64, 0);
+    for (int i = 0; i < n; i++) inv_rows[used_bits[i]] = b[i];
+
+    compile_kernels();
+}
+
+static uint64_t parity_encode(const std::vector<uint64_t>& rows, uint64_t line) {
+    uint64_t packed = 0;
+    for (size_t k = 0; k < rows.size(); k++) {
+        packed |= static_cast<uint64_t>(__builtin_parityll(line & rows[k])) << k;
+    }
+    return packed;
+}
+
+static uint64_t parity_decode(const std::vector<uint64_t>& rows, uint64_t packed) {
+    uint64_t line = 0;
+    for (size_t j = 0; j < rows.size(); j++) {
+        line |= static_cast<uint64_t>(__builtin_parityll(packed & rows[j])) << j;
+    }
+    return line;
+}
+
+// the matrix is linear over GF(2): the image of an address is the XOR of the images of its nibbles
+static inline uint64_t nibble_lookup(const uint64_t* table, size_t positions, uint64_t value) {
+    uint64_t out = 0;
+    for (size_t i = 0; i < positions; i++) {
+        out ^= table[i * 16 + ((value >> (4 * i)) & 0xF)];
+    }
+    return out;
+}
+
+#ifdef REMU_HAVE_NEON_KERNEL
+// [nibble position][output byte][nibble value] byte tables of a nibble table, and the number of
+// output bytes that are not always zero
+static std::vector<uint8_t> byte_planes(const std::vector<uint64_t>& nibble, size_t& planes) {
+    uint64_t used = 0;
+    for (uint64_t entry : nibble) used |= entry;
+    planes = used ? (64 - __builtin_clzll(used) + 7) / 8 : 0;
+    const size_t positions = nibble.size() / 16;
+    std::vector<uint8_t> table(positions * 8 * 16);
+    for (size_t i = 0; i < positions; i++) {
+        for (size_t b = 0; b < 8; b++) {
+            for (size_t v = 0; v < 16; v++) table[(i * 8 + b) * 16 + v] = uint8_t(nibble[i * 16 + v] >> (8 * b));
+        }
+    }
+    return table;
+}
+
+// 16 addresses per step: their bytes are transposed into planes (byte j of the 16 addresses),
+// the low and high nibbles of each plane index one 16-byte table per output byte (vqtbl1q_u8),
+// and the XOR-ed output planes are transposed back. The tail is left to the scalar kernel.
+static size_t neon_lookup(const uint8_t* table, size_t positions, size_t planes, const uint64_t* in, uint64_t* out,
+                          size_t n) {
+    const uint8x16_t low = vdupq_n_u8(0xF);
+    size_t k = 0;
+    for (; k + 16 <= n; k += 16) {
+        // byte j of address a is lane 2a (j < 4) or 2a + 1 (j >= 4) of val[j % 4]
+        uint8x16x4_t a = vld4q_u8(reinterpret_cast<const uint8_t*>(in + k));
+        uint8x16x4_t b = vld4q_u8(reinterpret_cast<const uint8_t*>(in + k + 8));
+        uint8x16_t src[8], acc[8];
+        for (int j = 0; j < 4; j++) {
+            src[j] = vuzp1q_u8(a.val[j], b.val[j]);
+            src[j + 4] = vuzp2q_u8(a.val[j], b.val[j]);
+        }
+        for (int j = 0; j < 8; j++) acc[j] = vdupq_n_u8(0);
+        for (size_t i = 0; i < positions; i++) {
+            const uint8x16_t idx = (i & 1) ? vshrq_n_u8(src[i / 2], 4) : vandq_u8(src[i / 2], low);
+            const uint8_t* t = table + i * 8 * 16;
+            for (size_t p = 0; p < planes; p++) acc[p] = veorq_u8(acc[p], vqtbl1q_u8(vld1q_u8(t + p * 16), idx));
+        }
+        uint8x16x4_t lo, hi;
+        for (int j = 0; j < 4; j++) {
+            lo.val[j] = vzip1q_u8(acc[j], acc[j + 4]);
+            hi.val[j] = vzip2q_u8(acc[j], acc[j + 4]);
+        }
+        vst4q_u8(reinterpret_cast<uint8_t*>(out + k), lo);
+        vst4q_u8(reinterpret_cast<uint8_t*>(out + k + 8), hi);
+    }
+    return k;
+}
+#endif
+
+void AddressMapper::compile_kernels() {
+    uint64_t used = 0;
+    for (uint64_t row : fwd_rows) used |= row;
+    int fwd_positions = 0;
+    while (fwd_positions < 16 && (used >> (4 * fwd_positions)) != 0) fwd_positions++;
+    int inv_positions = (packed_bits + 3) / 4;
+
+    fwd_nibble.assign(fwd_positions * 16, 0);
+    for (int i = 0; i < fwd_positions; i++) {
+        for (uint64_t v = 0; v < 16; v++) fwd_nibble[i * 16 + v] = parity_encode(fwd_rows, v << (4 * i));
+    }
+    inv_nibble.assign(inv_positions * 16, 0);
+    for (int i = 0; i < inv_positions; i++) {
+        for (uint64_t v = 0; v < 16; v++) inv_nibble[i * 16 + v] = parity_decode(inv_rows, v << (4 * i));
+    }
+
+#ifdef REMU_HAVE_NEON_KERNEL
+    // the nibble tables split into output bytes: [nibble position][output byte][nibble value]
+    neon_fwd = byte_planes(fwd_nibble, fwd_planes);
+    neon_inv = byte_planes(inv_nibble, inv_planes);
+#endif
+
+    // pext/pdep keep the bit order, so every field must take its bits in ascending or descending
+    // address order; a descending field is ascending in the bit-reversed address
+    pext_ok = true;
+    for (int f = 0; f < int(Field::MAX); f++) {
+        field_mask[f] = 0;
+        field_reverse[f] = false;
+        const std::vector<std::vector<int>>& bits = field_terms[f];
+        for (size_t bit = 0; bit < bits.size(); bit++) {
+            if (bits[bit].size() != 1) pext_ok = false;
+            field_mask[f] |= 1ULL << bits[bit][0];
+        }
+        if (!pext_ok || bits.size() < 2) continue;
+        const bool descending = bits[1][0] < bits[0][0];
+        for (size_t bit = 1; bit < bits.size(); bit++) {
+            if ((bits[bit][0] < bits[bit-1][0]) != descending) pext_ok = false;
+        }
+        if (descending) {
+            field_reverse[f] = true;
+            field_mask[f] = 0;
+            for (size_t bit = 0; bit < bits.size(); bit++) field_mask[f] |= 1ULL << (63 - bits[bit][0]);
+        }
+    }
+    if (set_kernel(Kernel::Bmi2)) return;
+    if (!set_kernel(Kernel::Neon)) set_kernel(Kernel::Nibble);
+}
+
+#ifdef REMU_HAVE_BMI2_KERNEL
+
+static inline uint64_t reverse_bits(uint64_t x) {
+    x = ((x >> 1) & 0x5555555555555555ULL) | ((x & 0x5555555555555555ULL) << 1);
+    x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+    x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+    return __builtin_bswap64(x);
+}
+
+// a descending field is extracted from and deposited into the bit-reversed line address, one
+// reversal per address however many fields descend
+__attribute__((target("bmi2")))
+static void bmi2_encode(const uint64_t* mask, const int* offset, const bool* reverse, const uint64_t* lines,
+                        uint64_t* packed, size_t n) {
+    for (size_t k = 0; k < n; k++) {
+        const uint64_t line = lines[k], rline = reverse_bits(line);
+        uint64_t p = 0;
+        for (int f = 0; f < int(AddressMapper::Field::MAX); f++) {
+            p |= _pext_u64(reverse[f] ? rline : line, mask[f]) << offset[f];
+        }
+        packed[k] = p;
+    }
+}
+
+__attribute__((target("bmi2")))
+static void bmi2_decode(const uint64_t* mask, const int* offset, const bool* reverse, const uint64_t* packed,
+                        uint64_t* lines, size_t n) {
+    for (size_t k = 0; k < n; k++) {
+        uint64_t line = 0, rline = 0;
+        for (int f = 0; f < int(AddressMapper::Field::MAX); f++) {
+            const uint64_t v = _pdep_u64(packed[k] >> offset[f], mask[f]);
+            if (reverse[f]) rline |= v;
+            else line |= v;
+        }
+        lines[k] = line | reverse_bits(rline);
+    }
+}
+#endif
+
+bool AddressMapper::set_kernel(Kernel k) {
+    if (k == Kernel::Bmi2) {
+#ifdef REMU_HAVE_BMI2_KERNEL
+        if (!pext_ok || !__builtin_cpu_supports("bmi2")) return false;
+#else
+        return false;
+#endif
+    }
+    if (k == Kernel::Neon) {
+#ifndef REMU_HAVE_NEON_KERNEL
+        return false;
+#endif
+    }
+    kernel = k;
+    return true;
+}
+
+const char* AddressMapper::kernel_str(Kernel k) {
+    switch (k) {
+        case Kernel::Parity: return "parity";
+        case Kernel::Nibble: return "nibble";
+        case Kernel::Bmi2: return "bmi2";
+        case Kernel::Neon: return "neon";
+        default: return "unknown";
+    }
+}
+
+void AddressMapper::encode_batch(const uint64_t* lines, uint64_t* packed, size_t n) const {
+    switch (kernel) {
+#ifdef REMU_HAVE_BMI2_KERNEL
+        case Kernel::Bmi2:
+            bmi2_encode(field_mask, field_offset, field_reverse, lines, packed, n);
+            break;
+#endif
+#ifdef REMU_HAVE_NEON_KERNEL
+        case Kernel::Neon: {
+            const size_t done = neon_lookup(neon_fwd.data(), fwd_nibble.size() / 16, fwd_planes, lines, packed, n);
+            const uint64_t* table = fwd_nibble.data();
+            const size_t positions = fwd_nibble.size() / 16;
+            for (size_t k = done; k < n; k++) packed[k] = nibble_lookup(table, positions, lines[k]);
+            break;
+        }
+#endif
+        case Kernel::Nibble: {
+            const uint64_t* table = fwd_nibble.data();
+            const size_t positions = fwd_nibble.size() / 16;
+            for (size_t k = 0; k < n; k++) packed[k] = nibble_lookup(table, positions, lines[k]);
+            break;
+        }
+        default:
+            for (size_t k = 0; k < n; k++) packed[k] = parity_encode(fwd_rows, lines[k]);
+    }
+}
+
+void AddressMapper::decode_batch(const uint64_t* packed, uint64_t* lines, size_t n) const {
+    switch (kernel) {
+#ifdef REMU_HAVE_BMI2_KERNEL
+        case Kernel::Bmi2:
+            bmi2_decode(field_mask, field_offset, field_reverse, packed, lines, n);
+            break;
+#endif
+#ifdef REMU_HAVE_NEON_KERNEL
+        case Kernel::Neon: {
+            const size_t done = neon_lookup(neon_inv.data(), inv_nibble.size() / 16, inv_planes, packed, lines, n);
+            const uint64_t* table = inv_nibble.data();
+            const size_t positions = inv_nibble.size() / 16;
+            for (size_t k = done; k < n; k++) lines[k] = nibble_lookup(table, positions, packed[k]);
+            break;
+        }
+#endif
+        case Kernel::Nibble: {
+            const uint64_t* table = inv_nibble.data();
+            const size_t positions = inv_nibble.size() / 16;
+            for (size_t k = 0; k < n; k++) lines[k] = nibble_lookup(table, positions, packed[k]);
+            break;
+        }
+        default:
+            for (size_t k = 0; k < n; k++) lines[k] = parity_decode(inv_rows, packed[k]);
+    }
+}
+
+uint64_t AddressMapper::encode(uint64_t line) const {
+    uint64_t packed;
+    encode_batch(&line, &packed, 1);
+    return packed;
+}
+
+uint64_t AddressMapper::decode(uint64_t packed) const {
+    uint64_t line;
+    decode_batch(&packed, &line, 1);
+    return line;
+}
+
+uint64_t AddressMapper::pack(const DramCoord& coord) const {
+    uint64_t packed = 0;
+    for (int f = 0; f < int(Field::MAX); f++) {
+        packed |= (static_cast<uint64_t>(coord.level[f]) & ((1ULL << width(Field(f))) - 1)) << field_offset[f];
+    }
+    return packed;
+}
+
+void AddressMapper::unpack(uint64_t packed, DramCoord& coord) const {
+    for (int f = 0; f < int(Field::MAX); f++) coord.level[f] = field(packed, Field(f));
+}
+
+void AddressMapper::forward(uintptr_t daddr, DramCoord& coord) const {
+    unpack(encode(daddr >> byte_bits), coord);
+}
+
+uintptr_t AddressMapper::inverse(const DramCoord& coord, uintptr_t byte) const {
+    return (static_cast<uintptr_t>(decode(pack(coord))) << byte_bits) | byte;
+}
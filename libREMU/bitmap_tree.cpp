@@ -1,11 +1,13 @@
 #include "bitmap_tree.h"
+#include "stats.h"
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <stdexcept>
 #include <unordered_set>
 #include <random>
+#include <algorithm>
 #include <unistd.h>
-#include <yaml-cpp/yaml.h>
 
 // BankNode 构造函数：预分配 column 节点
 BitmapTree::BankNode::BankNode(int idx, int num_columns)
@@ -45,90 +47,163 @@ void BitmapTree::initializeTree() {
     num_columns = 1 << column_bits;         // 2^(column_bits)
     num_rows = 1 << row_bits;
     rt = rtNode(num_banks, num_bankgroups, num_columns);
+    REMU_COUNT(TreeBytes, uint64_t(num_bankgroups) * (sizeof(BankGroupNode) + num_banks * (sizeof(BankNode) + num_columns * sizeof(ColumnNode))));
 }
 
-// 从物理地址（已右移 dq 后）中提取某个字段的值，依据 mapping 中给定的 bit 位列表。
-// 第 0 个元素为最低位。
-int BitmapTree::extractField(uintptr_t addr, const std::vector<int>& bits) {
-    int value = 0;
-    for (size_t i = 0; i < bits.size(); i++) {
-        value |= (((addr >> bits[i]) & 1UL) << i);
-    }
-    return value;
+// 把翻译后的坐标（AddressMapper::encode 的结果）拆成树的各层索引；channel、rank、bankgroup 合并为 bankgroup 层
+void BitmapTree::extractFields(uint64_t packed, int& bankgroup, int& bank, int& column, int& row) const {
+    typedef AddressMapper::Field Field;
+    bankgroup = mapper.field(packed, Field::Channel)
+              | (mapper.field(packed, Field::Rank) << mapper.width(Field::Channel))
+              | (mapper.field(packed, Field::BankGroup) << (mapper.width(Field::Channel) + mapper.width(Field::Rank)));
+    bank = mapper.field(packed, Field::Bank);
+    column = mapper.field(packed, Field::Column);
+    row = mapper.field(packed, Field::Row);
 }
 
-// 构造函数：解析 YAML 文件，读取 dram 层次和映射规则，并初始化树
-BitmapTree::BitmapTree(const std::string& mappingFile) {
-    try {
-        YAML::Node root = YAML::LoadFile(mappingFile);
-
-        // 解析 dram 层次参数，取 bankgroup、bank、column、row 四层
-        bankgroup_bits = root["dram"]["hierarchy"]["bankgroup_bits"].as<int>();
-        bank_bits = root["dram"]["hierarchy"]["bank_bits"].as<int>();
-        column_bits = root["dram"]["hierarchy"]["column_bits"].as<int>();
-        row_bits = root["dram"]["hierarchy"]["row_bits"].as<int>();
+// 各层索引打包成 AddressMapper 的坐标；逆映射在 getError 末尾批量完成（reverseMapping）
+uint64_t BitmapTree::packCoord(int bankgroup, int bank, int column, int row) const {
+    typedef AddressMapper::Field Field;
+    AddressMapper::DramCoord coord;
+    int ch_bits = mapper.width(Field::Channel), ra_bits = mapper.width(Field::Rank);
+    coord.level[int(Field::Channel)] = bankgroup & ((1 << ch_bits) - 1);
+    coord.level[int(Field::Rank)] = (bankgroup >> ch_bits) & ((1 << ra_bits) - 1);
+    coord.level[int(Field::BankGroup)] = bankgroup >> (ch_bits + ra_bits);
+    coord.level[int(Field::Bank)] = bank;
+    coord.level[int(Field::Column)] = column;
+    coord.level[int(Field::Row)] = row;
+    return mapper.pack(coord);
+}
 
-        // 解析 interface 部分：DQ 值（物理地址先右移 dq 位再映射）
-        dq = root["dram"]["interface"]["DQ"].as<int>();
+// 逆映射：打包坐标按块批量转换回物理地址（AddressMapper::decode_batch），再补上低 dq 位
+void BitmapTree::reverseMapping(std::vector<uintptr_t>& addrs, const std::vector<uintptr_t>& dqs) const {
+    const size_t chunk = 256;
+    uint64_t lines[chunk];
+    for (size_t base = 0; base < addrs.size(); base += chunk) {
+        size_t m = std::min(chunk, addrs.size() - base);
+        for (size_t k = 0; k < m; k++) lines[k] = addrs[base + k];
+        mapper.decode_batch(lines, lines, m);
+        for (size_t k = 0; k < m; k++) addrs[base + k] = (static_cast<uintptr_t>(lines[k]) << mapper.byte_bits) | dqs[base + k];
+    }
+}
 
-        // 解析映射规则（映射规则中各 key 对应的 vector 应与各层位宽匹配）
-        YAML::Node mappingNode = root["mapping"]["bit_mapping"];
-        map_column = mappingNode["column"].as<std::vector<int>>();
-        map_bankgroup = mappingNode["bankgroup"].as<std::vector<int>>();
-        map_bank = mappingNode["bank"].as<std::vector<int>>();
-        map_row = mappingNode["row"].as<std::vector<int>>();
+// 构造函数：编译映射规则（YAML 或 .map），由各字段位宽确定树的层次，并初始化树
+BitmapTree::BitmapTree(const std::string& mappingFile, int map_byte_bits) {
+    REMU_TIMED(TreeBuild);
+    typedef AddressMapper::Field Field;
+    mapper = AddressMapper::load(mappingFile, map_byte_bits);
+    dq = mapper.byte_bits;
 
-        // 初始化树
-        initializeTree();
+    bankgroup_bits = mapper.width(Field::Channel) + mapper.width(Field::Rank) + mapper.width(Field::BankGroup);
+    bank_bits = mapper.width(Field::Bank);
+    column_bits = mapper.width(Field::Column);
+    row_bits = mapper.width(Field::Row);
+    if (column_bits > 10 || row_bits > 17) {
+        throw std::invalid_argument("BitmapTree supports at most 10 column bits and 17 row bits");
     }
-    catch (const std::exception &e) {
-        std::cerr << "Error reading YAML file: " << e.what() << std::endl;
-        throw;
+
+    // 只出现在 row 项中的行地址位
+    uint64_t row_lines = 0, other_lines = 0;
+    for (int f = 0; f < int(Field::MAX); f++) {
+        for (const auto& sources : mapper.terms(Field(f))) {
+            for (int source : sources) {
+                (Field(f) == Field::Row ? row_lines : other_lines) |= (1ULL << source);
+            }
+        }
     }
+    row_only_lines = row_lines & ~other_lines;
+
+    // 初始化树
+    initializeTree();
 }
 
 BitmapTree::~BitmapTree() {}
 
 // addRange：对 [s_Daddr, t_Daddr] 范围内的每个物理地址，
 // 先右移 dq 位，再依照映射规则提取各层索引，并更新树中对应节点的 bitset 与叶子计数。
+// 范围拆成 2^k 对齐块；块内按子集枚举地址，只影响 row 的位在最内层，
+// 这样整片内存（如 64GB 全器件占用）的构建按 column 节点顺序访问 bitset。
 void BitmapTree::addRange(uintptr_t s_Daddr, uintptr_t t_Daddr) {
-    // 依次处理范围内的每个物理地址
+    REMU_TIMED(AddRange);
     s_Daddr>>=dq; t_Daddr>>=dq;
-    for (uintptr_t shifted = s_Daddr; shifted <= t_Daddr; shifted++) {
-        // 提取各层字段的值
-        int col_val = extractField(shifted, map_column);
-        int bankgroup_val = extractField(shifted, map_bankgroup);
-        int bank_val = extractField(shifted, map_bank);
-        int row_val = extractField(shifted, map_row);
+    // 地址按块批量翻译（AddressMapper::encode_batch），再逐个更新树
+    const size_t chunk = 1024;
+    uint64_t lines[chunk];
+    size_t n = 0;
+    uintptr_t base = s_Daddr;
+    while (base <= t_Daddr) {
+        // 从 base 开始、不超过 t_Daddr 的最大对齐块
+        int k = 0;
+        while (k < 62 && (base & ((2ULL << k) - 1)) == 0 && t_Daddr - base >= (2ULL << k) - 1) k++;
+        uint64_t inner = ((1ULL << k) - 1) & row_only_lines;
+        uint64_t outer = ((1ULL << k) - 1) & ~inner;
+        uint64_t o = 0;
+        do {
+            uint64_t r = 0;
+            do {
+                lines[n++] = base | o | r;
+                if (n == chunk) {
+                    updateLines(lines, n);
+                    n = 0;
+                }
+                r = (r - inner) & inner;  // inner 的下一个子集
+            } while (r);
+            o = (o - outer) & outer;
+        } while (o);
+        if (t_Daddr - base < (1ULL << k)) break;  // 已到 t_Daddr（避免 t_Daddr 为最大值时溢出）
+        base += (1ULL << k);
+    }
+    updateLines(lines, n);
+}
 
-        // 检查索引是否超出范围
-        if (bankgroup_val < 0 || bankgroup_val >= num_bankgroups ||
-            bank_val < 0 || bank_val >= num_banks ||
-            col_val < 0 || col_val >= num_columns || 
-            row_val < 0 || row_val >= num_rows ) {
-            std::cerr << "Extracted indices out of range for address: " <<shifted<< std::endl;
-            continue;
-        }
+void BitmapTree::updateLines(const uint64_t* lines, size_t n) {
+    const size_t chunk = 1024;
+    uint64_t packed[chunk];
+    ColumnNode* cols[chunk];
+    BankNode* banks[chunk];
+    BankGroupNode* bgs[chunk];
+    int rows[chunk];
+    for (size_t done = 0; done < n; done += chunk) {
+        size_t m = std::min<size_t>(chunk, n - done);
+        mapper.encode_batch(lines + done, packed, m);
+        // 第一遍：定位节点并预取 row 所在的 cache line；分散的地址每个叶子都落在不同的
+        // column bitset 上（TLB + cache miss），先发出全部预取，让这些访存并行
+        for (size_t k = 0; k < m; k++) {
+            // 提取各层字段的值
+            int col_val, bankgroup_val, bank_val, row_val;
+            extractFields(packed[k], bankgroup_val, bank_val, col_val, row_val);
 
-        // 定位到对应的节点
-        BankGroupNode &bgNode = rt.bankgroups[bankgroup_val];
-        BankNode &bNode = bgNode.banks[bank_val];
-        ColumnNode &colNode = bNode.columns[col_val];
+            // 检查索引是否超出范围
+            if (bankgroup_val < 0 || bankgroup_val >= num_bankgroups ||
+                bank_val < 0 || bank_val >= num_banks ||
+                col_val < 0 || col_val >= num_columns || 
+                row_val < 0 || row_val >= num_rows ) {
+                std::cerr << "Extracted indices out of range for address: " << lines[done + k] << std::endl;
+                cols[k] = nullptr;
+                continue;
+            }
 
-        // 对 bank 节点：如果对应的 column 尚未置 1，则置 1 并更新叶子计数
-        if (!bNode.column_bitmap.test(col_val)) {
-            bNode.column_bitmap.set(col_val);
+            // 定位到对应的节点
+            bgs[k] = &rt.bankgroups[bankgroup_val];
+            banks[k] = &bgs[k]->banks[bank_val];
+            cols[k] = &banks[k]->columns[col_val];
+            rows[k] = row_val;
+            // 对 bank 节点：标记对应的 column
+            banks[k]->column_bitmap.set(col_val);
+            __builtin_prefetch(reinterpret_cast<const char*>(&cols[k]->row_bitmap) + row_val / 8, 1);
+            __builtin_prefetch(&cols[k]->leaf_count, 1);
         }
-
-        // 对 column 节点：如果对应的 row 尚未置 1，则置 1 并更新叶子计数
-        if (!colNode.row_bitmap.test(row_val)) {
-            colNode.row_bitmap.set(row_val);
-            colNode.leaf_count++;  // 新的 row 更新
-            rt.leaf_count++;  
-            bNode.leaf_count++;    
-            bgNode.leaf_count++; 
+        // 第二遍：对 column 节点，如果对应的 row 尚未置 1，则置 1 并更新各层叶子计数
+        for (size_t k = 0; k < m; k++) {
+            ColumnNode* colNode = cols[k];
+            if (colNode && !colNode->row_bitmap.test(rows[k])) {
+                colNode->row_bitmap.set(rows[k]);
+                colNode->leaf_count++;  // 新的 row 更新
+                rt.leaf_count++;  
+                banks[k]->leaf_count++;    
+                bgs[k]->leaf_count++; 
+            }
         }
-
     }
 }
 
@@ -236,6 +311,7 @@ float y: the probability of occurring in the same bit-line, which means the same
 float z: the probability of occurring in the stacking direction, which means the same column, same row and adjacent DQ.
 */
 std::vector<uintptr_t> BitmapTree::getError(int num, int cnt, float x, float y, float z){
+    REMU_TIMED(Sample);
     std::vector<uintptr_t> errors;
     errors.clear();
     errors.reserve(num*cnt);
@@ -245,38 +321,10 @@ std::vector<uintptr_t> BitmapTree::getError(int num, int cnt, float x, float y,
         std::random_device rd;
         std::mt19937 gen(rd());
         std::uniform_int_distribution<uintptr_t> dqDist(0, (1UL << dq) - 1);        
+        // errors 先存打包坐标，dqs 存对应的 dq 位，返回前由 reverseMapping 批量逆映射
+        std::vector<uintptr_t> dqs;
+        dqs.reserve(num*cnt);
 
-        // 定义逆映射函数：将各层索引转换回物理地址（注意：物理地址在映射前右移过 dq 位）
-        auto reverseMapping = [this](int bg, int b, int c, int r, uintptr_t dq_rand) -> uintptr_t {
-            uintptr_t addr = 0;
-            int field = bg;
-            // bankgroup
-            for (size_t i = 0; i < map_bankgroup.size(); i++) {
-                if (field & (1 << i))
-                    addr |= (1UL << map_bankgroup[i]);
-            }
-            // bank
-            field = b;
-            for (size_t i = 0; i < map_bank.size(); i++) {
-                if (field & (1 << i))
-                    addr |= (1UL << map_bank[i]);
-            }
-            // column
-            field = c;
-            for (size_t i = 0; i < map_column.size(); i++) {
-                if (field & (1 << i))
-                    addr |= (1UL << map_column[i]);
-            }
-            // row
-            field = r;
-            for (size_t i = 0; i < map_row.size(); i++) {
-                if (field & (1 << i))
-                    addr |= (1UL << map_row[i]);
-            }
-            // 恢复 dq 位
-            addr = (addr << dq) | dq_rand;
-            return addr;
-        };      
         /**
         num==1的情况
         利用各层（rt、bankgroup、bank、column）的 leaf_count 信息，直接做分层随机采样，而不必遍历整个树。
@@ -286,12 +334,13 @@ std::vector<uintptr_t> BitmapTree::getError(int num, int cnt, float x, float y,
         重复采样，直到获得所需的 cnt 个唯一叶子（物理地址）。
         */
         if(num==1){
-            int totalLeaves = rt.leaf_count;
+            uint64_t totalLeaves = rt.leaf_count;
+            if (totalLeaves == 0) return errors;
             int seuFound = 0;
             while(seuFound < cnt) {
                 // 在全局范围内随机选一个目标下标 [0, totalLeaves-1]
-                int target = std::uniform_int_distribution<int>(0, totalLeaves - 1)(gen);
-                int remaining = target;
+                uint64_t target = std::uniform_int_distribution<uint64_t>(0, totalLeaves - 1)(gen);
+                uint64_t remaining = target;
                 int selected_bg = -1;
                 // 根据 bankgroup 的 leaf_count 定位目标 bankgroup
                 for (int bg = 0; bg < num_bankgroups; bg++) {
@@ -302,7 +351,7 @@ std::vector<uintptr_t> BitmapTree::getError(int num, int cnt, float x, float y,
                         remaining -= rt.bankgroups[bg].leaf_count;
                     }
                 }
-                if(selected_bg < 0) continue;
+                if(selected_bg < 0) { REMU_COUNT(Retries, 1); continue; }
                 
                 BankGroupNode &bgNode = rt.bankgroups[selected_bg];
                 int selected_bank = -1;
@@ -315,7 +364,7 @@ std::vector<uintptr_t> BitmapTree::getError(int num, int cnt, float x, float y,
                         remaining -= bgNode.banks[b].leaf_count;
                     }
                 }
-                if(selected_bank < 0) continue;
+                if(selected_bank < 0) { REMU_COUNT(Retries, 1); continue; }
                 
                 BankNode &bankNode = bgNode.banks[selected_bank];
                 int selected_col = -1;
@@ -331,34 +380,37 @@ std::vector<uintptr_t> BitmapTree::getError(int num, int cnt, float x, float y,
                         }
                     }
                 }
-                if(selected_col < 0) continue;
+                if(selected_col < 0) { REMU_COUNT(Retries, 1); continue; }
                 
                 ColumnNode &colNode = bankNode.columns[selected_col];
                 int selected_row = -1;
                 if (remaining > 0) selected_row = colNode.row_bitmap._Find_next(remaining - 1);
                 if(selected_row==colNode.row_bitmap.size()) selected_row=colNode.row_bitmap._Find_first();
-                if(selected_row < 0) continue;
+                if(selected_row < 0) { REMU_COUNT(Retries, 1); continue; }
                 
-                // 根据选中的 bankgroup、bank、column、row 得到物理地址
-                uintptr_t addr = reverseMapping(selected_bg, selected_bank, selected_col, selected_row, dqDist(gen));
-                errors.push_back(addr);
+                // 记录选中的 bankgroup、bank、column、row，物理地址在最后批量得到
+                errors.push_back(packCoord(selected_bg, selected_bank, selected_col, selected_row));
+                dqs.push_back(dqDist(gen));
                 seuFound++;
             }
+            reverseMapping(errors, dqs);
+            REMU_COUNT(Sampled, errors.size());
             return errors;
         }else{
-            int totalBankLeaves = 0;
+            uint64_t totalBankLeaves = 0;
             for (int bg = 0; bg < num_bankgroups; bg++) {
                 for (int b = 0; b < num_banks; b++) {
                     totalBankLeaves += rt.bankgroups[bg].banks[b].leaf_count;
                 }
             }
+            if (totalBankLeaves == 0) return errors;
             int mcuFound = 0;
             int MAX_ATTEMPTS = 128;
             int Attempts = 0;
             while(mcuFound < cnt && Attempts < MAX_ATTEMPTS*cnt){
                 Attempts++;
-                int target = std::uniform_int_distribution<int>(0, totalBankLeaves - 1)(gen);
-                int remaining = target;
+                uint64_t target = std::uniform_int_distribution<uint64_t>(0, totalBankLeaves - 1)(gen);
+                uint64_t remaining = target;
                 int selected_bg = -1;
                 int selected_bank = -1;
                 for (int bg = 0; bg < num_bankgroups; bg++) {
@@ -384,11 +436,12 @@ std::vector<uintptr_t> BitmapTree::getError(int num, int cnt, float x, float y,
                 for (int i = 1; i < x_num; i++) {
                     foundCols &= (bankNode.column_bitmap >> i);
                 }
-                if(foundCols.none())continue;
+                if(foundCols.none()) { REMU_COUNT(Retries, 1); continue; }
                 std::vector<int> foundColPos;
                 foundColPos.reserve(x_num);
                 int randStart = std::uniform_int_distribution<int>(0, 1023)(gen);
-                for(int col=randStart;col!=foundCols.size();col=foundCols._Find_next(col)){
+                int col=randStart;
+                for(;col!=foundCols.size();col=foundCols._Find_next(col)){
                     foundRows.set();
                     for(int i=0;i<x_num;i++){
                         foundRows &= (bankNode.columns[i+col].row_bitmap);
@@ -401,8 +454,8 @@ std::vector<uintptr_t> BitmapTree::getError(int num, int cnt, float x, float y,
                         if(selected_row==foundRows.size()) selected_row=foundRows._Find_first();
                         int selected_dq=dqDist(gen);
                         for(int i=0;i<x_num;i++){
-                            uintptr_t addr=reverseMapping(selected_bg, selected_bank, col+i, selected_row, selected_dq);
-                            errors.push_back(addr);
+                            errors.push_back(packCoord(selected_bg, selected_bank, col+i, selected_row));
+                            dqs.push_back(selected_dq);
                         }
                         mcuFound+=x_num;
                         for(int i=0;i<x_num;i++){
@@ -416,16 +469,19 @@ std::vector<uintptr_t> BitmapTree::getError(int num, int cnt, float x, float y,
                             if(selected_row==foundRows.size()) selected_row=foundRows._Find_first();                       
 
                             for(int j=0;j<y_num;j++){
-                                uintptr_t addr=reverseMapping(selected_bg, selected_bank, col+i, selected_row+j , selected_dq);
-                                errors.push_back(addr);
+                                errors.push_back(packCoord(selected_bg, selected_bank, col+i, selected_row+j));
+                                dqs.push_back(selected_dq);
                             }
                             mcuFound+=y_num;
                         }
                         break;
                     }
                 }
+                if(col==foundCols.size()) REMU_COUNT(Retries, 1); // no column run has a common row
             }
+            reverseMapping(errors, dqs);
         }
+        REMU_COUNT(Sampled, errors.size());
         return errors;
     }
 }
\ No newline at end of file
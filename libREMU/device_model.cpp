@@ -0,0 +1,58 @@
+#include "device_model.h"
+#include <sys/stat.h>
+
+using namespace famulator;
+
+DeviceModelCache& DeviceModelCache::instance() {
+    static DeviceModelCache cache;
+    return cache;
+}
+
+void DeviceModelCache::clear() {
+    std::lock_guard<std::mutex> guard(lock);
+    models.clear();
+    standards.clear();
+}
+
+size_t DeviceModelCache::size() {
+    std::lock_guard<std::mutex> guard(lock);
+    return models.size();
+}
+
+std::string DeviceModelCache::standard(const std::string& cfg) {
+    struct stat st;
+    if (stat(cfg.c_str(), &st) != 0) {
+        throw std::invalid_argument("Invalid config or mapping file!");
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = standards.find(cfg);
+    if (it != standards.end() && it->second.stamp.tv_sec == st.st_mtim.tv_sec &&
+        it->second.stamp.tv_nsec == st.st_mtim.tv_nsec) {
+        return it->second.standard;
+    }
+    std::string standard;
+    if (DeviceProfile::is_profile(cfg)) {
+        standard = DeviceProfile(cfg).standard();
+    } else {
+        Config configs(cfg);
+        standard = configs["standard"];
+    }
+    standards[cfg] = StandardEntry{st.st_mtim, standard};
+    return standard;
+}
+
+bool DeviceModelCache::Stamp::operator==(const Stamp& other) const {
+    return cfg.tv_sec == other.cfg.tv_sec && cfg.tv_nsec == other.cfg.tv_nsec &&
+           mapping.tv_sec == other.mapping.tv_sec && mapping.tv_nsec == other.mapping.tv_nsec;
+}
+
+bool DeviceModelCache::stamp_of(const std::string& cfg, const std::string& mapping, Stamp& stamp) {
+    struct stat st;
+    if (stat(cfg.c_str(), &st) != 0) return false;
+    stamp.cfg = st.st_mtim;
+    stamp.mapping = timespec();
+    if (DeviceProfile::is_profile(cfg)) return true; // self-contained
+    if (stat(mapping.c_str(), &st) != 0) return false;
+    stamp.mapping = st.st_mtim;
+    return true;
+}
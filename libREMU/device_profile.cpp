@@ -0,0 +1,220 @@
+#include "device_profile.h"
+#include "device_model.h"
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <cstring>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace famulator;
+
+static const char profile_magic[8] = {'R', 'E', 'M', 'U', 'P', 'R', 'O', 'F'};
+
+static uint32_t fnv1a(const uint8_t* data, size_t n) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < n; i++) {
+        h ^= data[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void copy_field(char* dst, size_t n, const std::string& src, const char* what) {
+    if (src.size() >= n) {
+        throw std::invalid_argument(std::string(what) + " name too long for a profile: " + src);
+    }
+    std::memcpy(dst, src.c_str(), src.size() + 1);
+}
+
+// organization of the configured part, taken from the spec class the registry binds it to
+template <class T>
+static void describe(const Config& configs, ProfileHeader& h) {
+    std::unique_ptr<T> spec(make_spec(configs["standard"], configs["org"], configs["speed"], static_cast<T*>(nullptr)));
+    spec->set_channel_number(configs.get_channels());
+    spec->set_rank_number(configs.get_ranks());
+    h.channel_width = spec->channel_width;
+    h.prefetch_size = spec->prefetch_size;
+    h.dq = spec->org_entry.dq;
+    for (int lvl = 0; lvl < int(T::Level::MAX); lvl++) {
+        for (int f = 0; f < int(AddressMapper::Field::MAX); f++) {
+            if (T::level_str[lvl] == AddressMapper::field_str[f]) h.count[f] = spec->org_entry.count[lvl];
+        }
+    }
+}
+
+bool DeviceProfile::is_profile(const std::string& filename) {
+    size_t dot = filename.rfind('.');
+    return dot != std::string::npos && filename.substr(dot) == ".remu";
+}
+
+void DeviceProfile::compile(const std::string& cfg, const std::string& mapping, const std::string& out, int map_byte_bits) {
+    ProfileHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, profile_magic, sizeof(profile_magic));
+    h.version = VERSION;
+    h.family = uint32_t(DRAMFamily::MAX);
+
+    int byte_bits = map_byte_bits;
+    if (!cfg.empty()) {
+        if (!std::ifstream(cfg).good()) {
+            throw std::invalid_argument("Cannot open config " + cfg);
+        }
+        Config configs(cfg);
+        const std::string standard = configs["standard"];
+        const DRAMStandardInfo* info = find_dram_standard(standard);
+        if (!info) {
+            throw std::invalid_argument("Unsupported DRAM standard: " + standard);
+        }
+        if ((configs.get_channels() & (configs.get_channels() - 1)) != 0 || (configs.get_ranks() & (configs.get_ranks() - 1)) != 0) {
+            throw std::invalid_argument("Channels and ranks must be powers of two.");
+        }
+        switch (info->family) {
+            case DRAMFamily::LPDDR4: describe<LPDDR4>(configs, h); break;
+            case DRAMFamily::Flat: describe<FlatDRAM>(configs, h); break;
+            default: describe<GroupedDRAM>(configs, h); break;
+        }
+        h.family = uint32_t(info->family);
+        copy_field(h.standard, sizeof(h.standard), standard, "Standard");
+        copy_field(h.org, sizeof(h.org), configs["org"], "Organization");
+        copy_field(h.speed, sizeof(h.speed), configs["speed"], "Speed");
+        h.channels = configs.get_channels();
+        h.ranks = configs.get_ranks();
+        byte_bits = 0;
+        while ((1 << (byte_bits + 1)) <= h.channel_width / 8) byte_bits++;
+    }
+
+    size_t dot = mapping.rfind('.');
+    std::string ext = dot == std::string::npos ? "" : mapping.substr(dot);
+    if (!std::ifstream(mapping).good()) {
+        throw std::invalid_argument("Cannot open mapping " + mapping);
+    }
+    AddressMapper mapper = (ext == ".yaml" || ext == ".yml") ? AddressMapper::fromYaml(mapping)
+                                                             : AddressMapper::fromMapFile(mapping, byte_bits);
+    if (h.standard[0] != '\0') {
+        if (mapper.byte_bits != byte_bits) {
+            throw std::invalid_argument("DQ of " + mapping + " (" + std::to_string(1 << mapper.byte_bits)
+                                        + " bytes) does not match the channel width of " + cfg);
+        }
+        for (int f = 0; f < int(AddressMapper::Field::MAX); f++) {
+            AddressMapper::Field field = AddressMapper::Field(f);
+            if (mapper.width(field) > 0 && h.count[f] == 0) {
+                throw std::invalid_argument(std::string("Mapping has ") + AddressMapper::field_str[f]
+                                            + " bits but " + h.standard + " has no such level");
+            }
+            if (h.count[f] > 0 && (1LL << mapper.width(field)) > h.count[f]) {
+                std::cerr << "[Warning] " << AddressMapper::field_str[f] << ": " << mapper.width(field)
+                          << " mapping bits exceed the " << h.count[f] << " entries of " << h.org << std::endl;
+            }
+        }
+    }
+
+    std::vector<uint32_t> terms;
+    for (int f = 0; f < int(AddressMapper::Field::MAX); f++) {
+        const std::vector<std::vector<int>>& field_terms = mapper.terms(AddressMapper::Field(f));
+        h.width[f] = int32_t(field_terms.size());
+        for (const auto& sources : field_terms) {
+            terms.push_back(uint32_t(sources.size()));
+            for (int source : sources) terms.push_back(uint32_t(source));
+        }
+    }
+    const std::vector<uint64_t>& fwd = mapper.forward_rows();
+    const std::vector<uint64_t>& inv = mapper.inverse_rows();
+    h.byte_bits = mapper.byte_bits;
+    h.burst_length = mapper.burst_length;
+    h.coord_bits = mapper.coord_bits();
+    h.fwd_offset = sizeof(ProfileHeader);
+    h.inv_offset = h.fwd_offset + uint32_t(fwd.size() * sizeof(uint64_t));
+    h.terms_offset = h.inv_offset + uint32_t(inv.size() * sizeof(uint64_t));
+    h.terms_count = uint32_t(terms.size());
+    h.file_size = h.terms_offset + uint32_t(terms.size() * sizeof(uint32_t));
+
+    std::vector<uint8_t> image(h.file_size);
+    std::memcpy(image.data() + h.fwd_offset, fwd.data(), fwd.size() * sizeof(uint64_t));
+    std::memcpy(image.data() + h.inv_offset, inv.data(), inv.size() * sizeof(uint64_t));
+    std::memcpy(image.data() + h.terms_offset, terms.data(), terms.size() * sizeof(uint32_t));
+    h.checksum = fnv1a(image.data() + sizeof(ProfileHeader), image.size() - sizeof(ProfileHeader));
+    std::memcpy(image.data(), &h, sizeof(h));
+
+    // written next to the target and renamed, readers never see a partial profile
+    const std::string tmp = out + ".tmp";
+    {
+        std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(image.data()), image.size());
+        if (!file.good()) {
+            throw std::invalid_argument("Cannot write " + tmp);
+        }
+    }
+    if (std::rename(tmp.c_str(), out.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        throw std::invalid_argument("Cannot write " + out + ": " + strerror(errno));
+    }
+}
+
+DeviceProfile::DeviceProfile(const std::string& filename) : head(nullptr), base(MAP_FAILED), length(0) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd == -1) {
+        throw std::runtime_error("Cannot open profile " + filename + ": " + strerror(errno));
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size >= static_cast<off_t>(sizeof(ProfileHeader))) {
+        length = static_cast<size_t>(st.st_size);
+        base = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (base == MAP_FAILED) {
+        throw std::runtime_error("Cannot map profile " + filename);
+    }
+    head = static_cast<const ProfileHeader*>(base);
+    const uint8_t* bytes = static_cast<const uint8_t*>(base);
+
+    const char* error = nullptr;
+    if (std::memcmp(head->magic, profile_magic, sizeof(profile_magic)) != 0) error = "not a REMU device profile";
+    else if (head->version != VERSION) error = "unsupported profile version";
+    else if (head->file_size != length) error = "truncated profile";
+    else if (head->coord_bits < 0 || head->coord_bits > 64
+             || head->fwd_offset != sizeof(ProfileHeader)
+             || head->inv_offset != head->fwd_offset + head->coord_bits * sizeof(uint64_t)
+             || head->terms_offset != head->inv_offset + 64 * sizeof(uint64_t)
+             || head->terms_offset + uint64_t(head->terms_count) * sizeof(uint32_t) != length) error = "corrupt profile layout";
+    else if (fnv1a(bytes + sizeof(ProfileHeader), length - sizeof(ProfileHeader)) != head->checksum) error = "profile checksum mismatch";
+    if (error) {
+        munmap(base, length);
+        throw std::runtime_error(filename + ": " + error);
+    }
+}
+
+DeviceProfile::~DeviceProfile() {
+    if (base != MAP_FAILED) munmap(base, length);
+}
+
+std::string DeviceProfile::field_string(const char* s, size_t n) {
+    return std::string(s, strnlen(s, n));
+}
+
+AddressMapper DeviceProfile::mapper() const {
+    const uint8_t* bytes = static_cast<const uint8_t*>(base);
+    const uint32_t* stream = reinterpret_cast<const uint32_t*>(bytes + head->terms_offset);
+    const uint32_t* end = stream + head->terms_count;
+    std::vector<std::vector<int>> terms[int(AddressMapper::Field::MAX)];
+    for (int f = 0; f < int(AddressMapper::Field::MAX); f++) {
+        if (head->width[f] < 0 || head->width[f] > 32) {
+            throw std::runtime_error("Corrupt profile: field width out of range");
+        }
+        terms[f].resize(head->width[f]);
+        for (auto& sources : terms[f]) {
+            if (stream == end || *stream > uint32_t(end - stream - 1)) {
+                throw std::runtime_error("Corrupt profile: truncated mapping terms");
+            }
+            uint32_t n = *stream++;
+            sources.assign(stream, stream + n);
+            stream += n;
+        }
+    }
+    return AddressMapper::fromCompiled(terms, head->byte_bits, head->burst_length,
+                                       reinterpret_cast<const uint64_t*>(bytes + head->fwd_offset), head->coord_bits,
+                                       reinterpret_cast<const uint64_t*>(bytes + head->inv_offset));
+}
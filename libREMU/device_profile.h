@@ -0,0 +1,79 @@
+#ifndef DEVICE_PROFILE_H
+#define DEVICE_PROFILE_H
+
+#include "address_mapper.h"
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Fixed header of a compiled device profile (.remu). It is followed by the forward rows
+ * (coord_bits x uint64), the inverse rows (64 x uint64) and the mapping terms as uint32
+ * (per field and bit: number of sources, then the source address bits).
+ */
+struct ProfileHeader {
+    char magic[8];          // "REMUPROF"
+    uint32_t version;
+    uint32_t file_size;
+    uint32_t checksum;      // FNV-1a of everything after the header
+    uint32_t family;        // DRAMFamily, MAX if the profile has no device
+    char standard[16];      // empty for mapping-only profiles
+    char org[32];
+    char speed[32];
+    int32_t channels;
+    int32_t ranks;
+    int32_t channel_width;
+    int32_t prefetch_size;
+    int32_t dq;
+    int32_t count[6];       // Ch, Ra, Bg, Ba, Ro, Co of the organization
+    int32_t byte_bits;
+    int32_t burst_length;
+    int32_t coord_bits;
+    int32_t width[6];       // bits of each AddressMapper::Field
+    uint32_t fwd_offset;
+    uint32_t inv_offset;
+    uint32_t terms_offset;
+    uint32_t terms_count;
+};
+
+/**
+ * A device description (ramulator .cfg plus a .map or YAML mapping) compiled by
+ * tools/remu_compile.cpp into one versioned binary file. Loading is a single mmap and
+ * a checksum; no config, .map or YAML parsing happens at runtime.
+ */
+class DeviceProfile {
+public:
+    enum { VERSION = 1 };
+
+    // map and validate a profile, throws std::runtime_error
+    explicit DeviceProfile(const std::string& filename);
+    ~DeviceProfile();
+    DeviceProfile(const DeviceProfile&) = delete;
+    DeviceProfile& operator=(const DeviceProfile&) = delete;
+
+    /**
+     * Validate `cfg` (may be empty for a mapping-only profile) and `mapping` and write the
+     * profile to `out`. `map_byte_bits` is used for a .map file without a cfg. Throws
+     * std::invalid_argument on invalid inputs.
+    */
+    static void compile(const std::string& cfg, const std::string& mapping, const std::string& out, int map_byte_bits = 4);
+
+    // by extension (.remu)
+    static bool is_profile(const std::string& filename);
+
+    const ProfileHeader& header() const { return *head; }
+    bool has_device() const { return head->standard[0] != '\0'; }
+    std::string standard() const { return field_string(head->standard, sizeof(head->standard)); }
+    std::string org() const { return field_string(head->org, sizeof(head->org)); }
+    std::string speed() const { return field_string(head->speed, sizeof(head->speed)); }
+    AddressMapper mapper() const;
+
+private:
+    const ProfileHeader* head;
+    void* base;
+    size_t length;
+
+    static std::string field_string(const char* s, size_t n);
+};
+
+#endif // DEVICE_PROFILE_H
@@ -0,0 +1,60 @@
+#include "dram_arena.h"
+#include <new>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/mman.h>
+
+DramArena::DramArena(size_t bytes, const SyntheticSource::Layout& config)
+    : layout(config), memfd(-1), start(nullptr), bytes((bytes + 4095) & ~size_t(4095)), top(0) {
+    if (this->bytes == 0 || this->bytes > (uint64_t(config.capacity_gb) << 30)) {
+        throw std::invalid_argument("DRAM arena does not fit the layout capacity");
+    }
+    memfd = memfd_create("remu_dram", MFD_CLOEXEC);
+    if (memfd < 0) throw std::runtime_error(std::string("memfd_create failed: ") + strerror(errno));
+    if (ftruncate(memfd, off_t(this->bytes)) != 0) {
+        int err = errno;
+        close(memfd);
+        throw std::runtime_error(std::string("Cannot size the DRAM arena: ") + strerror(err));
+    }
+    void* p = mmap(nullptr, this->bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, memfd, 0);
+    if (p == MAP_FAILED) {
+        int err = errno;
+        close(memfd);
+        throw std::runtime_error(std::string("Cannot map the DRAM arena: ") + strerror(err));
+    }
+    start = static_cast<char*>(p);
+}
+
+DramArena::~DramArena() {
+    munmap(start, bytes);
+    close(memfd);
+}
+
+void* DramArena::allocate(size_t size) {
+    size = (size + 4095) & ~size_t(4095);
+    if (size > bytes - top) throw std::bad_alloc();
+    void* p = start + top;
+    top += size;
+    return p;
+}
+
+uintptr_t DramArena::physical(const void* p) const {
+    uintptr_t offset = reinterpret_cast<uintptr_t>(p) - reinterpret_cast<uintptr_t>(start);
+    return layout.translate(offset >> 12) | (offset & 4095);
+}
+
+bool DramArena::iomem(std::string& text) {
+    return layout.iomem(text);
+}
+
+ssize_t DramArena::pagemap(pid_t, uintptr_t first_page, size_t count, uint64_t* entries) {
+    const uintptr_t first = reinterpret_cast<uintptr_t>(start) >> 12;
+    const uintptr_t pages = bytes >> 12;
+    for (size_t i = 0; i < count; i++) {
+        uintptr_t page = first_page + i - first;
+        entries[i] = page < pages ? (1ULL << 63) | (layout.translate(page) >> 12) : 0;
+    }
+    return ssize_t(count * sizeof(uint64_t));
+}
@@ -0,0 +1,59 @@
+#ifndef DRAM_ARENA_H
+#define DRAM_ARENA_H
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include "system_source.h"
+
+/**
+ * Emulated DRAM for rootless, reproducible campaigns.
+ *
+ * The arena is one private mapping of a memfd ("remu_dram" in /proc/<pid>/maps). Data placed in
+ * it (e.g. the model weights) gets its "physical" addresses from a SyntheticSource layout instead
+ * of the kernel: arena page i is at layout.translate(i), whatever the virtual address of the
+ * arena. As a SystemSource it reports that layout as /proc/iomem and answers pagemap lookups for
+ * its pages with an O(1) computation, so MemUtils plans and injects into the arena without root
+ * or pagemap reads, and the same layout is reproduced on every machine and run. Pages outside
+ * the arena are reported as not present.
+ *
+ * The mapping is private: flips made in a forked trial stay in the child.
+ */
+class DramArena : public SystemSource {
+public:
+    // an arena of `bytes` (rounded up to whole pages) in `layout`; throws std::invalid_argument
+    // when it does not fit the layout and std::runtime_error when the memfd cannot be mapped
+    explicit DramArena(size_t bytes, const SyntheticSource::Layout& layout = SyntheticSource::Layout());
+    ~DramArena();
+    DramArena(const DramArena&) = delete;
+    DramArena& operator=(const DramArena&) = delete;
+
+    // the next page-aligned block of `size` bytes, std::bad_alloc when the arena is full
+    void* allocate(size_t size);
+    // forget every allocation (the contents are kept)
+    void reset() { top = 0; }
+
+    bool contains(const void* p) const {
+        return reinterpret_cast<uintptr_t>(p) - reinterpret_cast<uintptr_t>(start) < bytes;
+    }
+    // the emulated physical address of a byte of the arena
+    uintptr_t physical(const void* p) const;
+
+    char* base() const { return start; }
+    size_t size() const { return bytes; }
+    size_t used() const { return top; }
+    int fd() const { return memfd; }
+    const SyntheticSource& source() const { return layout; }
+
+    bool iomem(std::string& text) override;
+    ssize_t pagemap(pid_t pid, uintptr_t first_page, size_t count, uint64_t* entries) override;
+
+private:
+    SyntheticSource layout;
+    int memfd;
+    char* start;
+    size_t bytes;
+    size_t top;
+};
+
+#endif // DRAM_ARENA_H
@@ -0,0 +1,189 @@
+#include "ecc.h"
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+
+static int popcount8(uint8_t v) {
+    int n = 0;
+    for (; v; v &= v - 1) n++;
+    return n;
+}
+
+EccModel::EccModel() : EccModel(Scheme::None) {}
+
+EccModel::EccModel(Scheme scheme)
+    : mode(scheme), word_size(1), sym_bits(0), sym_data(0), sym_check(0), gf_order(0)
+{
+    reset_stats();
+    std::memset(secded_syndrome, 0, sizeof(secded_syndrome));
+    std::fill(secded_column, secded_column + 256, -1);
+}
+
+EccModel EccModel::secded() {
+    EccModel ecc(Scheme::SECDED);
+    ecc.word_size = 8;
+    ecc.init_secded();
+    return ecc;
+}
+
+EccModel EccModel::symbol(int symbol_bits, int data_symbols, int check_symbols) {
+    if (symbol_bits != 4 && symbol_bits != 8) {
+        throw std::invalid_argument("ECC symbol size must be 4 or 8 bits");
+    }
+    if (check_symbols != 2 && check_symbols != 3) {
+        throw std::invalid_argument("ECC symbol code needs 2 (SSC) or 3 (SSC-DSD) check symbols");
+    }
+    if (data_symbols <= 0 || data_symbols + check_symbols > (1 << symbol_bits) - 1) {
+        throw std::invalid_argument("ECC codeword longer than the symbol field allows");
+    }
+    size_t bytes = static_cast<size_t>(data_symbols) * symbol_bits / 8;
+    // words never straddle a page, so every byte of a word shares one V->P translation
+    if (bytes == 0 || (data_symbols * symbol_bits) % 8 != 0 || (bytes & (bytes - 1)) != 0 || bytes > 4096) {
+        throw std::invalid_argument("ECC data word must be a power-of-two number of bytes");
+    }
+    EccModel ecc(Scheme::Symbol);
+    ecc.word_size = bytes;
+    ecc.sym_bits = symbol_bits;
+    ecc.sym_data = data_symbols;
+    ecc.sym_check = check_symbols;
+    ecc.init_symbol();
+    return ecc;
+}
+
+void EccModel::reset_stats() {
+    std::memset(&counters, 0, sizeof(counters));
+}
+
+const char* EccModel::outcome_str(Outcome outcome) {
+    switch (outcome) {
+        case Outcome::Corrected: return "corrected";
+        case Outcome::Detected: return "detected";
+        case Outcome::Miscorrected: return "miscorrected";
+        case Outcome::Undetected: return "undetected";
+        default: return "unknown";
+    }
+}
+
+// Hsiao (72,64): 64 distinct odd-weight data columns (all 56 weight-3 columns and the first
+// 8 weight-5 columns) plus the 8 unit check columns.
+void EccModel::init_secded() {
+    uint8_t columns[64];
+    int n = 0;
+    for (int weight = 3; weight <= 5 && n < 64; weight += 2) {
+        for (int v = 0; v < 256 && n < 64; v++) {
+            if (popcount8(static_cast<uint8_t>(v)) == weight) columns[n++] = static_cast<uint8_t>(v);
+        }
+    }
+    for (int j = 0; j < 64; j++) secded_column[columns[j]] = static_cast<int16_t>(j);
+    for (int c = 0; c < 8; c++) secded_column[1 << c] = -2;
+
+    for (int byte = 0; byte < 8; byte++) {
+        for (int v = 0; v < 256; v++) {
+            uint8_t s = 0;
+            for (int bit = 0; bit < 8; bit++) {
+                if (v & (1 << bit)) s ^= columns[byte * 8 + bit];
+            }
+            secded_syndrome[byte][v] = s;
+        }
+    }
+}
+
+void EccModel::init_symbol() {
+    gf_order = (1 << sym_bits) - 1;
+    const int poly = (sym_bits == 4) ? 0x13 : 0x11D; // x^4+x+1, x^8+x^4+x^3+x^2+1
+    gf_exp.assign(2 * gf_order, 0);
+    gf_log.assign(gf_order + 1, 0);
+    int x = 1;
+    for (int i = 0; i < gf_order; i++) {
+        gf_exp[i] = x;
+        gf_log[x] = i;
+        x <<= 1;
+        if (x & (1 << sym_bits)) x ^= poly;
+    }
+    for (int i = gf_order; i < 2 * gf_order; i++) gf_exp[i] = gf_exp[i - gf_order];
+}
+
+int EccModel::gf_mul(int a, int b) const {
+    if (a == 0 || b == 0) return 0;
+    return gf_exp[gf_log[a] + gf_log[b]];
+}
+
+int EccModel::gf_pow_alpha(int power) const {
+    return gf_exp[power % gf_order];
+}
+
+EccModel::Outcome EccModel::decode_secded(uint8_t* data) const {
+    uint8_t s = 0;
+    for (int byte = 0; byte < 8; byte++) s ^= secded_syndrome[byte][data[byte]];
+    if (s == 0) return Outcome::Undetected;
+    int col = secded_column[s];
+    if (col == -2) return Outcome::Undetected; // the decoder repairs a check bit, data stays corrupted
+    if (col < 0) return Outcome::Detected;
+    data[col / 8] ^= static_cast<uint8_t>(1 << (col % 8));
+    for (int byte = 0; byte < 8; byte++) {
+        if (data[byte]) return Outcome::Miscorrected;
+    }
+    return Outcome::Corrected;
+}
+
+EccModel::Outcome EccModel::decode_symbol(uint8_t* data) const {
+    const int per_byte = 8 / sym_bits;
+    const int sym_mask = (1 << sym_bits) - 1;
+    int s0 = 0, s1 = 0, s2 = 0;
+    for (int i = 0; i < sym_data; i++) {
+        int e = (data[i / per_byte] >> (sym_bits * (i % per_byte))) & sym_mask;
+        if (!e) continue;
+        s0 ^= e;
+        s1 ^= gf_mul(e, gf_pow_alpha(i));
+        if (sym_check == 3) s2 ^= gf_mul(e, gf_pow_alpha(2 * i));
+    }
+    if (s0 == 0 && s1 == 0 && s2 == 0) return Outcome::Undetected;
+    if (s0 == 0 || s1 == 0) return Outcome::Detected;
+    if (sym_check == 3 && gf_mul(s1, s1) != gf_mul(s0, s2)) return Outcome::Detected;
+
+    int pos = (gf_log[s1] - gf_log[s0] + gf_order) % gf_order;
+    if (pos >= sym_data + sym_check) return Outcome::Detected;
+    if (pos >= sym_data) return Outcome::Undetected; // "corrects" a check symbol
+
+    data[pos / per_byte] ^= static_cast<uint8_t>(s0 << (sym_bits * (pos % per_byte)));
+    for (size_t byte = 0; byte < word_size; byte++) {
+        if (data[byte]) return Outcome::Miscorrected;
+    }
+    return Outcome::Corrected;
+}
+
+std::vector<Vflip> EccModel::filter(const std::vector<Vflip>& flips) {
+    std::vector<Vflip> sorted(flips);
+    std::sort(sorted.begin(), sorted.end(), [](const Vflip& a, const Vflip& b) { return a.paddr < b.paddr; });
+
+    std::vector<Vflip> residue;
+    residue.reserve(sorted.size());
+    std::vector<uint8_t> word(word_size);
+    size_t i = 0;
+    while (i < sorted.size()) {
+        const uintptr_t word_pa = sorted[i].paddr - sorted[i].paddr % word_size;
+        const uintptr_t word_va = sorted[i].vaddr - sorted[i].paddr % word_size;
+        std::fill(word.begin(), word.end(), 0);
+        for (; i < sorted.size() && sorted[i].paddr - word_pa < word_size; i++) {
+            word[sorted[i].paddr - word_pa] ^= sorted[i].mask;
+        }
+
+        size_t planned = 0;
+        for (size_t b = 0; b < word_size; b++) planned += popcount8(word[b]);
+        if (planned == 0) continue;
+        counters.words++;
+        counters.planned_bits += planned;
+
+        Outcome outcome = Outcome::Undetected;
+        if (mode == Scheme::SECDED) outcome = decode_secded(word.data());
+        else if (mode == Scheme::Symbol) outcome = decode_symbol(word.data());
+        counters.outcome[int(outcome)]++;
+
+        for (size_t b = 0; b < word_size; b++) {
+            if (!word[b]) continue;
+            counters.residual_bits += popcount8(word[b]);
+            residue.push_back({word_va + b, word_pa + b, word[b]});
+        }
+    }
+    return residue;
+}
@@ -0,0 +1,95 @@
+#ifndef ECC_H
+#define ECC_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "mem_utils.h"
+
+/**
+ * ECC emulation stage between error planning and flip application.
+ *
+ * Planned flips are grouped by ECC data word (by physical address), the syndrome of each
+ * word is computed with table-driven kernels, and only the residue the decoder would leave
+ * in the data is returned for application.
+ */
+class EccModel {
+public:
+    enum class Scheme {
+        None,    // no ECC, every planned flip reaches the data
+        SECDED,  // (72,64) Hsiao SECDED, one 8-byte data word per codeword
+        Symbol,  // Reed-Solomon style single-symbol-correct code (chipkill-like)
+    };
+
+    enum class Outcome {
+        Corrected,     // the decoder restores the original data
+        Detected,      // uncorrectable error is flagged, data left as is
+        Miscorrected,  // the decoder "corrects" the wrong bit/symbol, silently
+        Undetected,    // zero syndrome (or check-only correction), silently
+        MAX
+    };
+
+    struct Stats {
+        size_t words;                         // ECC words touched by at least one flip
+        size_t outcome[int(Outcome::MAX)];    // words per outcome
+        size_t planned_bits;                  // flipped bits before decoding
+        size_t residual_bits;                 // flipped bits left in the data after decoding
+    };
+
+    // no ECC
+    EccModel();
+
+    /**
+     * Symbol-based code over GF(2^symbol_bits) (symbol_bits = 4 or 8) with data_symbols data
+     * symbols and check_symbols (2: SSC, 3: SSC-DSD) check symbols per codeword.
+     * The ECC word covers data_symbols*symbol_bits/8 bytes.
+     */
+    static EccModel symbol(int symbol_bits, int data_symbols, int check_symbols);
+    // (72,64) SECDED
+    static EccModel secded();
+
+    Scheme scheme() const { return mode; }
+    size_t word_bytes() const { return word_size; }
+
+    /**
+     * Decode the planned flips word by word and return the uncorrected residue.
+     * The input may contain several flips in the same byte; the output has one entry per
+     * corrupted byte.
+     */
+    std::vector<Vflip> filter(const std::vector<Vflip>& flips);
+
+    const Stats& stats() const { return counters; }
+    void reset_stats();
+    static const char* outcome_str(Outcome outcome);
+
+private:
+    explicit EccModel(Scheme scheme);
+
+    Scheme mode;
+    size_t word_size;
+    Stats counters;
+
+    // SECDED: syndrome contribution of every byte value at every byte position of the data word
+    uint8_t secded_syndrome[8][256];
+    // SECDED: data bit corrected for every syndrome (-1: none, -2: check bit)
+    int16_t secded_column[256];
+
+    // Symbol code: GF(2^m) log/antilog tables
+    int sym_bits;
+    int sym_data;
+    int sym_check;
+    int gf_order;  // 2^m - 1
+    std::vector<int> gf_log;
+    std::vector<int> gf_exp;
+
+    void init_secded();
+    void init_symbol();
+    int gf_mul(int a, int b) const;
+    int gf_pow_alpha(int power) const;
+
+    // Decode one word, `data` holds the per-byte error masks and is replaced by the residue.
+    Outcome decode_secded(uint8_t* data) const;
+    Outcome decode_symbol(uint8_t* data) const;
+};
+
+#endif // ECC_H
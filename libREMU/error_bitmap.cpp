@@ -1,3 +1,23 @@
 #include "error_bitmap.h"
 
 template class ErrorBitmap<LPDDR4>;
+template class ErrorBitmap<FlatDRAM>;
+template class ErrorBitmap<GroupedDRAM>;
+
+std::unique_ptr<ErrorBitmapBase> ErrorBitmapBase::create(const std::string& cfg, uintptr_t start, uintptr_t end, uintptr_t page_size) {
+    // cached with the device models, so repeated campaigns do not re-read the cfg
+    const std::string standard = DeviceModelCache::instance().standard(cfg);
+    const DRAMStandardInfo* info = find_dram_standard(standard);
+    if (!info) {
+        throw std::invalid_argument("Unsupported DRAM standard: " + standard);
+    }
+    switch (info->family) {
+        case DRAMFamily::LPDDR4:
+            return std::unique_ptr<ErrorBitmapBase>(new ErrorBitmap<LPDDR4>(start, end, page_size));
+        case DRAMFamily::Flat:
+            return std::unique_ptr<ErrorBitmapBase>(new ErrorBitmap<FlatDRAM>(start, end, page_size));
+        case DRAMFamily::Grouped:
+        default:
+            return std::unique_ptr<ErrorBitmapBase>(new ErrorBitmap<GroupedDRAM>(start, end, page_size));
+    }
+}
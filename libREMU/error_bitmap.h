@@ -4,7 +4,10 @@
 #include "src/Config.h"
 #include "src/Memory.h"
 #include "src/LPDDR4.h"
+#include "src/DRAMStandard.h"
+#include "device_model.h"
 #include <vector>
+#include <memory>
 #include <iostream>
 #include <ctime>
 #include <random>
@@ -13,20 +16,33 @@
 using namespace std;
 using namespace famulator;
 
+class ErrorBitmapBase {
+public:
+    virtual ~ErrorBitmapBase() {}
+    virtual void REMU(const std::string& cfg, const std::string& mapping = "") = 0;
+    virtual std::vector<uintptr_t> calculateError(int error_bit_num, int seed) = 0;
+
+    /**
+     * Read the standard of `cfg` (a ramulator .cfg or a compiled .remu profile) and return the ErrorBitmap instantiation of its family
+     * (see src/DRAMStandard.h). REMU(cfg, mapping) still has to be called on the result.
+    */
+    static std::unique_ptr<ErrorBitmapBase> create(const std::string& cfg, uintptr_t start, uintptr_t end, uintptr_t page_size);
+};
+
 template <typename T>
-class ErrorBitmap {
+class ErrorBitmap : public ErrorBitmapBase {
 private:
     uintptr_t s_paddr;
     uintptr_t e_paddr;
     uintptr_t page_size;
     // int error_bit_num;
     // int seed;
-    Memory<T>* memory;
+    std::unique_ptr<Memory<T>> memory; // per-range state over a cached DeviceModel<T>
 
 public:
     ErrorBitmap(uintptr_t start, uintptr_t end, uintptr_t page_size);
-    void REMU(const std::string& cfg, const std::string& mapping = "");
-    std::vector<uintptr_t> calculateError(int error_bit_num, int seed);
+    void REMU(const std::string& cfg, const std::string& mapping = "") override;
+    std::vector<uintptr_t> calculateError(int error_bit_num, int seed) override;
 };
 
 template <typename T>
@@ -36,14 +52,14 @@ ErrorBitmap<T>::ErrorBitmap(uintptr_t start, uintptr_t end, uintptr_t page_size)
 template<typename T>
 std::vector<uintptr_t> ErrorBitmap<T>::calculateError(int error_bit_num, int seed) {
     vector<uintptr_t> errors; 
-    int ro_ref;
-    int co_ref;
+    int64_t ro_ref;
+    int64_t co_ref;
     mt19937 gen;
     gen.seed(seed);
-    uniform_int_distribution<int> dist_ro(memory->s_lvl[int(T::Level::Row)], memory->e_lvl[int(T::Level::Row)]);
+    uniform_int_distribution<int64_t> dist_ro(memory->s_lvl[int(T::Level::Row)], memory->e_lvl[int(T::Level::Row)]);
     //  Channel, Rank, Bank, Row
-    int co_min;
-    int co_max;
+    int64_t co_min;
+    int64_t co_max;
     if(memory->e_vec[int(T::Level::Channel)] == 0 && memory->e_vec[int(T::Level::Rank)] == 0 && memory->e_vec[int(T::Level::Bank)] == 0 && memory->e_vec[int(T::Level::Row)] == 0){
         assert((memory->s_lvl[int(T::Level::Column)] != memory->e_lvl[int(T::Level::Column)]) && (memory->e_vec[int(T::Level::Column)] != 0) && "Invalid column");
         co_min = memory->s_lvl[int(T::Level::Column)];
@@ -51,12 +67,12 @@ std::vector<uintptr_t> ErrorBitmap<T>::calculateError(int error_bit_num, int see
     }
     else{
         co_min = 0;
-        co_max = (1 << memory->e_vec[int(T::Level::Column)])-1;
+        co_max = (int64_t(1) << memory->e_vec[int(T::Level::Column)])-1;
         memory->s_lvl[int(T::Level::Column)] = co_min;
         memory->e_lvl[int(T::Level::Column)] = co_max;
     }
     // cout << "co_min-co_max: " << co_min << " " <<co_max << endl;
-    uniform_int_distribution<int> dist_co(co_min, co_max);
+    uniform_int_distribution<int64_t> dist_co(co_min, co_max);
     ro_ref = dist_ro(gen);
     co_ref = dist_co(gen);
     if(memory->s_lvl[int(T::Level::Row)] == memory->e_lvl[int(T::Level::Row)]){
@@ -75,40 +91,19 @@ std::vector<uintptr_t> ErrorBitmap<T>::calculateError(int error_bit_num, int see
 
 template <typename T>
 void ErrorBitmap<T>::REMU(const std::string& cfg, const std::string& mapping) {
-    // configuration settings
-    Config configs(cfg);
-    const std::string& standard = configs["standard"];
-    if (standard == "") {
-        throw std::invalid_argument("DRAM standard should be specified.");
-    }
-
-    // mapping settings
-    if (!mapping.empty()) {
-        configs.add("mapping", mapping);
-    } else {
+    // mapping settings (a compiled profile carries its own)
+    if (mapping.empty() && !DeviceProfile::is_profile(cfg)) {
         throw std::invalid_argument("Mapping is empty!");
     }
 
-    std::ifstream file(configs["mapping"]);
-    if (!file.good()) {
-        throw std::invalid_argument("Invalid mapping or bad mapping file!");
-    }
-
-    std::vector<uintptr_t> errors;
-    if (standard == "LPDDR4") {
-        LPDDR4* lpddr4 = new LPDDR4(configs["org"], configs["speed"]);
-        int C = configs.get_channels(), R = configs.get_ranks();
-        // Check and Set channel, rank number
-        lpddr4->set_channel_number(C);
-        lpddr4->set_rank_number(R);
-        memory = new Memory<T>(lpddr4, configs);
-        memory->getAddressInfo(s_paddr, e_paddr); 
-        // for(int i=0; i<static_cast<int>(memory->s_vec.size()); i++){
-        //     cout<<"s_vec \t"<<lpddr4->level_str[i]<<": "<<memory->s_vec[i]<<endl;
-        // }
-        // for(int i=0; i<static_cast<int>(memory->e_vec.size()); i++){
-        //     cout<<"e_vec \t"<<lpddr4->level_str[i]<<": "<<memory->e_vec[i]<<endl;
-        // }
-    }
+    // configuration, spec and mapping are parsed once per (cfg, mapping) and shared
+    memory.reset(new Memory<T>(DeviceModelCache::instance().get<T>(cfg, mapping)));
+    memory->getAddressInfo(s_paddr, e_paddr);
+    // for(int i=0; i<static_cast<int>(memory->s_vec.size()); i++){
+    //     cout<<"s_vec \t"<<T::level_str[i]<<": "<<memory->s_vec[i]<<endl;
+    // }
+    // for(int i=0; i<static_cast<int>(memory->e_vec.size()); i++){
+    //     cout<<"e_vec \t"<<T::level_str[i]<<": "<<memory->e_vec[i]<<endl;
+    // }
 }
 #endif // ERROR_BITMAP_H
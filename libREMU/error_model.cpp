@@ -0,0 +1,269 @@
+#include "error_model.h"
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <climits>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const char emap_magic[8] = {'R', 'E', 'M', 'U', 'E', 'M', 'A', 'P'};
+
+std::map<int, int> ErrorMapBatch::at(size_t i) const {
+    std::map<int, int> error_count;
+    for (uint32_t e = offsets[i]; e < offsets[i + 1]; e++) error_count[multiplicity[e]] = count[e];
+    return error_count;
+}
+
+int ErrorMapBatch::total_bits(size_t i) const {
+    int bits = 0;
+    for (uint32_t e = offsets[i]; e < offsets[i + 1]; e++) bits += multiplicity[e] * count[e];
+    return bits;
+}
+
+void ErrorMapBatch::write_text(std::ostream& out) const {
+    for (size_t i = 0; i < size(); i++) {
+        for (uint32_t e = offsets[i]; e < offsets[i + 1]; e++) out << multiplicity[e] << ":" << count[e] << " ";
+        out << "\n";
+    }
+}
+
+void ErrorMapBatch::read_text(std::istream& in) {
+    if (offsets.empty()) offsets.push_back(0);
+    std::string line;
+    while (std::getline(in, line)) {
+        // get_error.py writes the SEUs last; a std::map restores the ascending order
+        std::map<int, int> error_count;
+        std::istringstream iss(line);
+        int error, count;
+        char colon;
+        while (iss >> error >> colon >> count) error_count[error] = count;
+        for (const auto& pair : error_count) {
+            multiplicity.push_back(pair.first);
+            this->count.push_back(pair.second);
+        }
+        offsets.push_back(static_cast<uint32_t>(multiplicity.size()));
+    }
+}
+
+ErrorMapFile::ErrorMapFile(const std::string& filename)
+    : head(nullptr), offsets(nullptr), entries(nullptr), base(MAP_FAILED), length(0)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd == -1) {
+        throw std::runtime_error("Cannot open error maps " + filename + ": " + strerror(errno));
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size >= static_cast<off_t>(sizeof(ErrorMapHeader))) {
+        length = static_cast<size_t>(st.st_size);
+        base = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (base == MAP_FAILED) {
+        throw std::runtime_error("Cannot map error maps " + filename);
+    }
+    head = static_cast<const ErrorMapHeader*>(base);
+    offsets = reinterpret_cast<const uint32_t*>(head + 1);
+
+    // only the layout is checked here, offsets are checked per access to keep opening O(1)
+    const char* error = nullptr;
+    if (std::memcmp(head->magic, emap_magic, sizeof(emap_magic)) != 0) error = "not a REMU error-map file";
+    else if (head->version != VERSION) error = "unsupported error-map version";
+    else if (head->file_size != length) error = "truncated error-map file";
+    else if (head->maps > length / sizeof(uint32_t) || head->entries > length / sizeof(uint32_t)
+             || sizeof(ErrorMapHeader) + (head->maps + 1 + head->entries) * sizeof(uint32_t) != length) error = "corrupt error-map layout";
+    if (error) {
+        munmap(base, length);
+        throw std::runtime_error(filename + ": " + error);
+    }
+    entries = offsets + head->maps + 1;
+}
+
+ErrorMapFile::~ErrorMapFile() {
+    if (base != MAP_FAILED) munmap(base, length);
+}
+
+std::map<int, int> ErrorMapFile::at(size_t i) const {
+    if (i >= head->maps) {
+        throw std::out_of_range("Error map " + std::to_string(i) + " of " + std::to_string(head->maps));
+    }
+    uint32_t begin = offsets[i], end = offsets[i + 1];
+    if (begin > end || end > head->entries) {
+        throw std::runtime_error("Corrupt error-map offsets at map " + std::to_string(i));
+    }
+    std::map<int, int> error_count;
+    for (uint32_t e = begin; e < end; e++) error_count[int(entries[e] >> COUNT_BITS)] = int(entries[e] & ((1u << COUNT_BITS) - 1));
+    return error_count;
+}
+
+bool ErrorMapFile::is_error_map_file(const std::string& filename) {
+    size_t dot = filename.rfind('.');
+    return dot != std::string::npos && filename.substr(dot) == ".emap";
+}
+
+void ErrorMapFile::write(const ErrorMapBatch& batch, const std::string& out) {
+    ErrorMapHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, emap_magic, sizeof(emap_magic));
+    h.version = VERSION;
+    h.maps = batch.size();
+    h.entries = batch.multiplicity.size();
+    h.file_size = sizeof(h) + (h.maps + 1 + h.entries) * sizeof(uint32_t);
+
+    std::vector<uint32_t> table(batch.offsets.begin(), batch.offsets.end());
+    if (table.empty()) table.push_back(0);
+    std::vector<uint32_t> packed(h.entries);
+    for (size_t e = 0; e < h.entries; e++) {
+        if (batch.multiplicity[e] < 0 || batch.multiplicity[e] > 255 || batch.count[e] < 0 || batch.count[e] >= (1 << COUNT_BITS)) {
+            throw std::invalid_argument("Error map entry " + std::to_string(batch.multiplicity[e]) + ":" + std::to_string(batch.count[e])
+                                        + " does not fit the .emap format");
+        }
+        packed[e] = (uint32_t(batch.multiplicity[e]) << COUNT_BITS) | uint32_t(batch.count[e]);
+    }
+
+    // written next to the target and renamed, readers never see a partial file
+    const std::string tmp = out + ".tmp";
+    {
+        std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        file.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(uint32_t));
+        file.write(reinterpret_cast<const char*>(packed.data()), packed.size() * sizeof(uint32_t));
+        if (!file.good()) {
+            throw std::invalid_argument("Cannot write " + tmp);
+        }
+    }
+    if (std::rename(tmp.c_str(), out.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        throw std::invalid_argument("Cannot write " + out + ": " + strerror(errno));
+    }
+}
+
+std::map<int, int> ErrorMapFile::load(const std::string& filename, int line) {
+    if (is_error_map_file(filename)) {
+        ErrorMapFile file(filename);
+        if (line < 1 || static_cast<size_t>(line) > file.size()) return std::map<int, int>();
+        return file.at(line - 1);
+    }
+    std::map<int, int> error_count;
+    std::ifstream infile(filename);
+    if (!infile.is_open()) {
+        throw std::runtime_error("Cannot open error maps " + filename);
+    }
+    std::string text;
+    for (int current_line = 1; std::getline(infile, text); current_line++) {
+        if (current_line != line) continue;
+        std::istringstream iss(text);
+        int error, count;
+        char colon;
+        while (iss >> error >> colon >> count) error_count[error] = count;
+        break;
+    }
+    return error_count;
+}
+
+ErrorModel::ErrorModel(double mean, bool poisson, const Fractions& fractions)
+    : mean_bits(mean), poisson_total(poisson), frac(fractions)
+{
+    if (!(mean >= 0) || mean > INT_MAX) {
+        throw std::invalid_argument("Expected flipped bits must be in [0, INT_MAX]");
+    }
+    const double bounds[] = {frac.mbu2_min, frac.mbu2_max, frac.mbu3_max, frac.mbun_max};
+    for (double f : bounds) {
+        if (!(f >= 0 && f <= 1)) throw std::invalid_argument("MBU fractions must be in [0, 1]");
+    }
+    if (frac.mbu2_min > frac.mbu2_max) {
+        throw std::invalid_argument("mbu2_min is larger than mbu2_max");
+    }
+    // otherwise every draw flips more than the total and is rejected forever
+    if (frac.mbu2_min > 0.5) {
+        throw std::invalid_argument("mbu2_min above 0.5 always flips more than the total bits");
+    }
+    if (frac.mbun_min_bits < 4 || frac.mbun_min_bits > frac.mbun_max_bits) {
+        throw std::invalid_argument("N-bit MBU sizes must be a range above 3 bits");
+    }
+}
+
+ErrorModel ErrorModel::fixed(int total_bits, const Fractions& fractions) {
+    return ErrorModel(total_bits, false, fractions);
+}
+
+ErrorModel ErrorModel::flux(double flux, double cross_section, double seconds, const Fractions& fractions) {
+    if (!(flux >= 0) || !(cross_section >= 0) || !(seconds >= 0)) {
+        throw std::invalid_argument("Flux, cross-section and exposure time must be non-negative");
+    }
+    return ErrorModel(flux * cross_section * seconds, true, fractions);
+}
+
+int ErrorModel::draw_total(std::mt19937_64& gen) const {
+    if (!poisson_total) return static_cast<int>(mean_bits);
+    if (mean_bits == 0) return 0;
+    return std::poisson_distribution<int>(mean_bits)(gen);
+}
+
+void ErrorModel::draw_map(int total, std::mt19937_64& gen, std::vector<int>& multiplicity, std::vector<int>& count) const {
+    typedef std::uniform_int_distribution<int> Uniform;
+    // int(total * fraction), as get_error.py
+    const int mbu2_lo = static_cast<int>(total * frac.mbu2_min);
+    const int mbu2_hi = static_cast<int>(total * frac.mbu2_max);
+    const int mbu3_hi = static_cast<int>(total * frac.mbu3_max);
+    const int mbun_hi = static_cast<int>(total * frac.mbun_max);
+    const int sizes = frac.mbun_max_bits - frac.mbun_min_bits + 1;
+    std::vector<int> mbun(sizes);
+
+    for (;;) {
+        int mbu2 = Uniform(mbu2_lo, mbu2_hi)(gen);
+        int mbu3 = Uniform(0, mbu3_hi)(gen);
+        int left = Uniform(0, mbun_hi)(gen);
+        int64_t flipped = 2 * int64_t(mbu2) + 3 * int64_t(mbu3);
+        // uniform size per N-bit event: a multinomial split of the event count
+        for (int s = 0; s < sizes; s++) {
+            mbun[s] = s + 1 == sizes ? left : std::binomial_distribution<int>(left, 1.0 / (sizes - s))(gen);
+            left -= mbun[s];
+            flipped += int64_t(mbun[s]) * (frac.mbun_min_bits + s);
+        }
+        if (flipped > total) continue;
+
+        const int seu = total - static_cast<int>(flipped);
+        if (seu) { multiplicity.push_back(1); count.push_back(seu); }
+        if (mbu2) { multiplicity.push_back(2); count.push_back(mbu2); }
+        if (mbu3) { multiplicity.push_back(3); count.push_back(mbu3); }
+        for (int s = 0; s < sizes; s++) {
+            if (mbun[s]) { multiplicity.push_back(frac.mbun_min_bits + s); count.push_back(mbun[s]); }
+        }
+        return;
+    }
+}
+
+std::map<int, int> ErrorModel::sample(std::mt19937_64& gen) const {
+    std::vector<int> multiplicity, count;
+    draw_map(draw_total(gen), gen, multiplicity, count);
+    std::map<int, int> error_count;
+    for (size_t e = 0; e < multiplicity.size(); e++) error_count[multiplicity[e]] = count[e];
+    return error_count;
+}
+
+ErrorMapBatch ErrorModel::sample(size_t n, uint64_t seed) const {
+    std::mt19937_64 gen(seed);
+    ErrorMapBatch batch;
+    sample(n, gen, batch);
+    return batch;
+}
+
+void ErrorModel::sample(size_t n, std::mt19937_64& gen, ErrorMapBatch& batch) const {
+    if (batch.offsets.empty()) batch.offsets.push_back(0);
+    batch.offsets.reserve(batch.offsets.size() + n);
+    // at most SEU, 2-bit, 3-bit and one entry per N-bit size per map
+    batch.multiplicity.reserve(batch.multiplicity.size() + n * (3 + frac.mbun_max_bits - frac.mbun_min_bits + 1));
+    batch.count.reserve(batch.multiplicity.capacity());
+    for (size_t i = 0; i < n; i++) {
+        draw_map(draw_total(gen), gen, batch.multiplicity, batch.count);
+        if (batch.multiplicity.size() > UINT32_MAX) {
+            throw std::length_error("ErrorMapBatch holds at most 2^32 entries");
+        }
+        batch.offsets.push_back(static_cast<uint32_t>(batch.multiplicity.size()));
+    }
+}
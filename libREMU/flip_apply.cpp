@@ -0,0 +1,239 @@
+#include "flip_apply.h"
+#include <algorithm>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+size_t FlipApplier::apply(const std::vector<Vflip>& flips) const {
+    std::vector<Vflip> failed;
+    return apply(flips, failed);
+}
+
+size_t FlipApplier::apply(const std::vector<Vflip>& flips, std::vector<Vflip>& failed) const {
+    std::vector<Vflip> sorted(flips);
+    std::sort(sorted.begin(), sorted.end(), [](const Vflip& a, const Vflip& b) { return a.vaddr < b.vaddr; });
+
+    failed.clear();
+    if (pid != 0 && (mode == Mode::Direct || mode == Mode::Mprotect)) {
+        std::cerr << "[Error] Direct and Mprotect flips cannot target another process." << std::endl;
+        failed = sorted;
+        return 0;
+    }
+    size_t applied = 0;
+    switch (mode) {
+        case Mode::Direct:
+            return apply_direct(sorted);
+        case Mode::Mprotect:
+            return apply_mprotect(sorted, failed);
+        case Mode::ProcMem:
+            applied = apply_procmem(sorted, failed, pid);
+            break;
+        case Mode::Remote: {
+            std::vector<Vflip> readonly;
+            applied = apply_remote(sorted, readonly, pid);
+            if (!readonly.empty()) applied += apply_procmem(readonly, failed, pid);
+            break;
+        }
+        case Mode::Auto:
+        default:
+            applied = apply_procmem(sorted, failed, pid);
+            if (!failed.empty() && pid == 0) {
+                std::vector<Vflip> retry;
+                retry.swap(failed);
+                return applied + apply_mprotect(retry, failed);
+            }
+            break;
+    }
+    if (!failed.empty()) {
+        std::cerr << "[Error] " << failed.size() << " flips could not be written through /proc/"
+                  << (pid ? std::to_string(pid) : std::string("self")) << "/mem." << std::endl;
+    }
+    return applied;
+}
+
+std::vector<FlipApplier::Span> FlipApplier::page_spans(const std::vector<Vflip>& flips) {
+    const uintptr_t page_size = sysconf(_SC_PAGE_SIZE);
+    std::vector<Span> spans;
+    for (size_t i = 0; i < flips.size(); i++) {
+        uintptr_t page = flips[i].vaddr & ~(page_size - 1);
+        if (spans.empty() || (spans.back().start & ~(page_size - 1)) != page) {
+            spans.push_back({flips[i].vaddr, flips[i].vaddr, i, i});
+        } else {
+            spans.back().end = flips[i].vaddr;
+            spans.back().last = i;
+        }
+    }
+    return spans;
+}
+
+size_t FlipApplier::apply_direct(const std::vector<Vflip>& flips) {
+    for (const auto& flip : flips) {
+        unsigned char* byteAddress = reinterpret_cast<unsigned char*>(flip.vaddr);
+        *byteAddress ^= flip.mask;
+    }
+    return flips.size();
+}
+
+size_t FlipApplier::apply_procmem(const std::vector<Vflip>& flips, std::vector<Vflip>& failed, pid_t pid) {
+    if (flips.empty()) return 0;
+    std::string path = pid ? "/proc/" + std::to_string(pid) + "/mem" : std::string("/proc/self/mem");
+    int fd = open(path.c_str(), O_RDWR);
+    if (fd == -1) {
+        failed = flips;
+        return 0;
+    }
+    std::vector<Span> spans = page_spans(flips);
+    std::vector<uint8_t> buf;
+    size_t applied = 0;
+    for (const Span& span : spans) {
+        // one pread per page span; only the flipped bytes are written back, so concurrent
+        // stores to the bytes between the flips are not overwritten
+        buf.resize(span.end - span.start + 1);
+        ssize_t n = pread(fd, buf.data(), buf.size(), static_cast<off_t>(span.start));
+        if (n != static_cast<ssize_t>(buf.size())) {
+            failed.insert(failed.end(), flips.begin() + span.first, flips.begin() + span.last + 1);
+            continue;
+        }
+        size_t i = span.first;
+        while (i <= span.last) {
+            // /proc/<pid>/mem writes one file range per call, so each run of adjacent flipped
+            // bytes is one pwrite
+            size_t j = i + 1;
+            while (j <= span.last && flips[j].vaddr == flips[j-1].vaddr + 1) j++;
+            for (size_t k = i; k < j; k++) buf[flips[k].vaddr - span.start] ^= flips[k].mask;
+            const size_t len = flips[j-1].vaddr - flips[i].vaddr + 1;
+            n = pwrite(fd, buf.data() + (flips[i].vaddr - span.start), len, static_cast<off_t>(flips[i].vaddr));
+            if (n == static_cast<ssize_t>(len)) {
+                applied += j - i;
+            } else {
+                failed.insert(failed.end(), flips.begin() + i, flips.begin() + j);
+            }
+            i = j;
+        }
+    }
+    close(fd);
+    return applied;
+}
+
+size_t FlipApplier::apply_remote(const std::vector<Vflip>& flips, std::vector<Vflip>& failed, pid_t pid) {
+    std::vector<Span> spans = page_spans(flips);
+    std::vector<uint8_t> buf;
+    std::vector<struct iovec> local, remote;
+    size_t applied = 0;
+    for (size_t s = 0; s < spans.size(); s += IOV_MAX) {
+        // one remote iovec per page span, all spans of a batch share one local buffer
+        size_t e = std::min<size_t>(spans.size(), s + IOV_MAX);
+        size_t total = 0;
+        for (size_t k = s; k < e; k++) total += spans[k].end - spans[k].start + 1;
+        buf.assign(total, 0);
+        local.clear();
+        remote.clear();
+        size_t pos = 0;
+        for (size_t k = s; k < e; k++) {
+            struct iovec l, r;
+            l.iov_base = buf.data() + pos;
+            l.iov_len = spans[k].end - spans[k].start + 1;
+            r.iov_base = reinterpret_cast<void*>(spans[k].start);
+            r.iov_len = l.iov_len;
+            local.push_back(l);
+            remote.push_back(r);
+            pos += l.iov_len;
+        }
+        ssize_t n = process_vm_readv(pid, local.data(), local.size(), remote.data(), remote.size(), 0);
+        if (n != static_cast<ssize_t>(total)) {
+            // unreadable through process_vm_readv, retry the whole batch through /proc/<pid>/mem
+            failed.insert(failed.end(), flips.begin() + spans[s].first, flips.begin() + spans[e-1].last + 1);
+            continue;
+        }
+        pos = 0;
+        for (size_t k = s; k < e; k++) {
+            for (size_t i = spans[k].first; i <= spans[k].last; i++) {
+                buf[pos + (flips[i].vaddr - spans[k].start)] ^= flips[i].mask;
+            }
+            pos += spans[k].end - spans[k].start + 1;
+        }
+        // partial transfers stop at an iovec boundary, e.g. at the first read-only page
+        n = process_vm_writev(pid, local.data(), local.size(), remote.data(), remote.size(), 0);
+        size_t done = n > 0 ? static_cast<size_t>(n) : 0;
+        pos = 0;
+        for (size_t k = s; k < e; k++) {
+            size_t len = spans[k].end - spans[k].start + 1;
+            if (pos + len <= done) {
+                applied += spans[k].last - spans[k].first + 1;
+            } else {
+                failed.insert(failed.end(), flips.begin() + spans[k].first, flips.begin() + spans[k].last + 1);
+            }
+            pos += len;
+        }
+    }
+    return applied;
+}
+
+size_t FlipApplier::apply_mprotect(const std::vector<Vflip>& flips, std::vector<Vflip>& failed) {
+    struct Vma {
+        uintptr_t start;
+        uintptr_t end;
+        int prot;
+    };
+    std::vector<Vma> vmas;
+    std::ifstream maps("/proc/self/maps");
+    std::string line;
+    while (std::getline(maps, line)) {
+        std::istringstream iss(line);
+        std::string range, perms;
+        if (!(iss >> range >> perms)) continue;
+        size_t dash = range.find('-');
+        if (dash == std::string::npos || perms.size() < 3) continue;
+        Vma vma;
+        vma.start = std::stoull(range.substr(0, dash), nullptr, 16);
+        vma.end = std::stoull(range.substr(dash + 1), nullptr, 16);
+        vma.prot = (perms[0] == 'r' ? PROT_READ : 0) | (perms[1] == 'w' ? PROT_WRITE : 0) | (perms[2] == 'x' ? PROT_EXEC : 0);
+        vmas.push_back(vma);
+    }
+
+    const uintptr_t page_size = sysconf(_SC_PAGE_SIZE);
+    size_t applied = 0;
+    size_t i = 0;
+    size_t v = 0;
+    while (i < flips.size()) {
+        while (v < vmas.size() && vmas[v].end <= flips[i].vaddr) v++;
+        if (v == vmas.size() || flips[i].vaddr < vmas[v].start) {
+            std::cerr << "[Error] Address " << std::hex << flips[i].vaddr << std::dec << " is not mapped." << std::endl;
+            failed.push_back(flips[i]);
+            i++;
+            continue;
+        }
+        size_t j = i;
+        while (j < flips.size() && flips[j].vaddr < vmas[v].end) j++;
+        std::vector<Vflip> group(flips.begin() + i, flips.begin() + j);
+        if (vmas[v].prot & PROT_WRITE) {
+            applied += apply_direct(group);
+        } else {
+            // one toggle for all flipped pages of this VMA
+            uintptr_t lo = group.front().vaddr & ~(page_size - 1);
+            uintptr_t hi = (group.back().vaddr & ~(page_size - 1)) + page_size;
+            void* addr = reinterpret_cast<void*>(lo);
+            if (mprotect(addr, hi - lo, vmas[v].prot | PROT_READ | PROT_WRITE) != 0) {
+                std::cerr << "[Error] mprotect failed at " << std::hex << lo << std::dec << ": " << strerror(errno) << std::endl;
+                failed.insert(failed.end(), group.begin(), group.end());
+            } else {
+                applied += apply_direct(group);
+                mprotect(addr, hi - lo, vmas[v].prot);
+            }
+        }
+        i = j;
+    }
+    return applied;
+}
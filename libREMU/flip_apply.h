@@ -0,0 +1,62 @@
+#ifndef FLIP_APPLY_H
+#define FLIP_APPLY_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <sys/types.h>
+
+struct Vflip {
+    uintptr_t vaddr; /**< The virtual address of the corrupted byte. */
+    uintptr_t paddr; /**< The physical address of the corrupted byte. */
+    uint8_t mask;    /**< The bits to flip in this byte. */
+};
+
+class FlipApplier {
+    /**
+     * Applies per-byte flips to the memory of the current process, or of another process
+     * when a target pid is given.
+    */
+public:
+    enum class Mode {
+        Direct,   // dereference the virtual address (writable mappings only)
+        ProcMem,  // pread per page and pwrite per flipped run through /proc/self/mem, works on read-only mappings
+        Mprotect, // temporarily add PROT_WRITE, one mprotect toggle per VMA
+        Auto,     // ProcMem, falling back to Mprotect when /proc/self/mem is unavailable
+        Remote,   // process_vm_readv/writev into `pid`, falling back to /proc/<pid>/mem for read-only pages
+    };
+
+    explicit FlipApplier(Mode mode = Mode::Direct, pid_t pid = 0) : mode(mode), pid(pid) {}
+
+    /**
+     * Apply the flips and return the number of bytes that were changed.
+    */
+    size_t apply(const std::vector<Vflip>& flips) const;
+
+    /**
+     * Same as above; the flips that were not applied are returned in `failed`, sorted by vaddr.
+    */
+    size_t apply(const std::vector<Vflip>& flips, std::vector<Vflip>& failed) const;
+
+    Mode mode;
+    pid_t pid; // target process of ProcMem/Remote, 0 for the current process
+
+private:
+    struct Span {
+        uintptr_t start;  // first byte written
+        uintptr_t end;    // last byte written (inclusive)
+        size_t first;     // index range of the flips in the span
+        size_t last;
+    };
+
+    // coalesce sorted flips into one span per page
+    static std::vector<Span> page_spans(const std::vector<Vflip>& flips);
+
+    static size_t apply_direct(const std::vector<Vflip>& flips);
+    // flips that could not be written are returned in `failed`
+    static size_t apply_procmem(const std::vector<Vflip>& flips, std::vector<Vflip>& failed, pid_t pid);
+    static size_t apply_remote(const std::vector<Vflip>& flips, std::vector<Vflip>& failed, pid_t pid);
+    static size_t apply_mprotect(const std::vector<Vflip>& flips, std::vector<Vflip>& failed);
+};
+
+#endif // FLIP_APPLY_H
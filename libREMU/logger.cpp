@@ -0,0 +1,258 @@
+#include "logger.h"
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <cstring>
+#include <unistd.h>
+
+static int initial_level() {
+    const char* env = std::getenv("REMU_LOG_LEVEL");
+    if (env == nullptr) return int(Logger::Level::Info);
+    try {
+        return int(Logger::parse_level(env));
+    } catch (const std::invalid_argument&) {
+        std::cerr << "[Warn] Unknown REMU_LOG_LEVEL " << env << ", using info." << std::endl;
+        return int(Logger::Level::Info);
+    }
+}
+
+std::atomic<int> Logger::threshold(initial_level());
+
+Logger::Level Logger::parse_level(const std::string& name) {
+    static const char* names[] = {"quiet", "error", "warn", "info", "debug", "trace"};
+    for (int i = 0; i <= int(Level::Trace); i++) {
+        if (name == names[i]) return Level(i);
+    }
+    throw std::invalid_argument("Unknown log level " + name);
+}
+
+namespace {
+
+/**
+ * Bounded multi-producer ring (Vyukov): a slot whose sequence equals the position is free for
+ * that position, position + 1 means published. Producers reserve a position with a CAS on head
+ * and publish with a CAS on the slot, so a slot the consumer gave up on is never published late.
+ */
+class Ring {
+public:
+    enum { CAPACITY = 1 << 16 };
+    // a reserved slot that stays unpublished this long was abandoned (its writer jumped away)
+    enum { ABANDONED_MS = 1000 };
+
+    Ring() : slots(CAPACITY), head(0), tail(0), drained(0), lost(0), stop(false), owner(getpid()) {
+        for (size_t i = 0; i < CAPACITY; i++) slots[i].seq.store(i, std::memory_order_relaxed);
+        drain_thread = new std::thread(&Ring::run, this);
+    }
+
+    ~Ring() {
+        if (getpid() != owner) return; // a forked child does not have the drain thread
+        stop.store(true);
+        drain_thread->join();
+        delete drain_thread;
+    }
+
+    void push(const Logger::Record& record) {
+        uint64_t pos = head.load(std::memory_order_relaxed);
+        Slot* slot;
+        for (;;) {
+            slot = &slots[pos & (CAPACITY - 1)];
+            uint64_t seq = slot->seq.load(std::memory_order_acquire);
+            int64_t diff = int64_t(seq) - int64_t(pos);
+            if (diff == 0) {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                // full: wait for the drain thread, or drain here in a forked child
+                if (getpid() != owner) drain(true);
+                else std::this_thread::yield();
+                pos = head.load(std::memory_order_relaxed);
+            } else {
+                pos = head.load(std::memory_order_relaxed);
+            }
+        }
+        slot->record = record;
+        uint64_t expected = pos;
+        if (!slot->seq.compare_exchange_strong(expected, pos + 1, std::memory_order_release)) {
+            lost.fetch_add(1); // reclaimed by the consumer
+        }
+    }
+
+    void sync() {
+        uint64_t target = head.load(std::memory_order_acquire);
+        if (getpid() != owner) {
+            while (drain(true) || tail < target) {}
+            return;
+        }
+        while (drained.load(std::memory_order_acquire) < target) {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+
+    size_t dropped() const { return lost.load(); }
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> seq;
+        Logger::Record record;
+    };
+
+    std::vector<Slot> slots;
+    std::atomic<uint64_t> head;
+    uint64_t tail;                    // consumer only
+    std::atomic<uint64_t> drained;    // tail after the last flushed batch
+    std::atomic<size_t> lost;
+    std::atomic<bool> stop;
+    pid_t owner;
+    std::thread* drain_thread;
+    std::string pending;              // formatted lines not yet handed to their stream
+    std::chrono::steady_clock::time_point stall_since;
+    uint64_t stall_pos = ~uint64_t(0);
+
+    void run() {
+        while (true) {
+            if (drain(true)) continue;
+            if (stop.load() && tail == head.load()) break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    // one batch; returns whether anything was consumed. Unless `may_wait`, an unpublished slot
+    // ends the batch without being considered for reclaiming.
+    bool drain(bool may_wait) {
+        std::ostream* touched[8];
+        int ntouched = 0;
+        bool flush_all = false;
+        std::ostream* pending_sink = nullptr;
+        size_t n = 0;
+        while (n < 4096) {
+            Slot& slot = slots[tail & (CAPACITY - 1)];
+            uint64_t seq = slot.seq.load(std::memory_order_acquire);
+            if (seq != tail + 1) {
+                if (seq != tail || head.load(std::memory_order_acquire) <= tail || !may_wait) break;
+                // reserved but not published yet
+                auto now = std::chrono::steady_clock::now();
+                if (stall_pos != tail) {
+                    stall_pos = tail;
+                    stall_since = now;
+                    break;
+                }
+                if (now - stall_since < std::chrono::milliseconds(ABANDONED_MS)) break;
+                uint64_t expected = tail;
+                if (!slot.seq.compare_exchange_strong(expected, tail + CAPACITY, std::memory_order_acq_rel)) continue;
+                lost.fetch_add(1);
+                tail++;
+                n++;
+                continue;
+            }
+            write(slot.record, pending_sink);
+            std::ostream* out = pending_sink;
+            slot.seq.store(tail + CAPACITY, std::memory_order_release);
+            tail++;
+            n++;
+            bool seen = false;
+            for (int i = 0; i < ntouched; i++) seen |= touched[i] == out;
+            if (!seen) {
+                if (ntouched < 8) touched[ntouched++] = out;
+                else flush_all = true;
+            }
+        }
+        if (n == 0) return false;
+        flush_pending(pending_sink);
+        if (flush_all) {
+            std::cout.flush();
+            std::cerr.flush();
+        }
+        for (int i = 0; i < ntouched; i++) touched[i]->flush();
+        drained.store(tail, std::memory_order_release);
+        return true;
+    }
+
+    static void append_uint(std::string& out, uint64_t v, bool hex) {
+        char buf[24];
+        char* p = buf + sizeof(buf);
+        do {
+            unsigned digit = hex ? unsigned(v & 15) : unsigned(v % 10);
+            *--p = char(digit < 10 ? '0' + digit : 'a' + digit - 10);
+            v = hex ? v >> 4 : v / 10;
+        } while (v);
+        out.append(p, size_t(buf + sizeof(buf) - p));
+    }
+
+    // appends the formatted line of `r` to `out`
+    static void format(const Logger::Record& r, std::string& out) {
+        if (r.level == uint8_t(Logger::Level::Error)) out += "[Error] ";
+        else if (r.level == uint8_t(Logger::Level::Warn)) out += "[Warn] ";
+        int arg = 0;
+        const char* text = r.format;
+        for (const char* p = r.format; *p; p++) {
+            if (*p != '{' || arg >= r.nargs) continue;
+            bool hex = p[1] == 'x' && p[2] == '}';
+            if (!hex && p[1] != '}') continue;
+            out.append(text, size_t(p - text));
+            p += hex ? 2 : 1;
+            text = p + 1;
+            uint64_t v = r.args[arg];
+            switch (r.types[arg++]) {
+                case Logger::Int:
+                    if (!hex && int64_t(v) < 0) {
+                        out += '-';
+                        v = uint64_t(0) - v;
+                    }
+                    append_uint(out, v, hex);
+                    break;
+                case Logger::UInt:
+                    append_uint(out, v, hex);
+                    break;
+                case Logger::Double: {
+                    char buf[32];
+                    double d;
+                    std::memcpy(&d, &v, sizeof(d));
+                    std::snprintf(buf, sizeof(buf), "%g", d);
+                    out += buf;
+                    break;
+                }
+                default:
+                    out += reinterpret_cast<const char*>(uintptr_t(v));
+                    break;
+            }
+        }
+        out += text;
+        out += '\n';
+    }
+
+    // lines for the same stream are written with one call
+    void write(const Logger::Record& r, std::ostream*& pending_sink) {
+        std::ostream* out = r.sink;
+        if (out == nullptr) out = r.level <= uint8_t(Logger::Level::Warn) ? &std::cerr : &std::cout;
+        if (out != pending_sink) flush_pending(pending_sink);
+        pending_sink = out;
+        format(r, pending);
+    }
+
+    void flush_pending(std::ostream* sink) {
+        if (sink != nullptr && !pending.empty()) sink->write(pending.data(), std::streamsize(pending.size()));
+        pending.clear();
+    }
+};
+
+Ring& ring() {
+    static Ring instance;
+    return instance;
+}
+
+} // namespace
+
+void Logger::push(const Record& record) {
+    ring().push(record);
+}
+
+void Logger::sync() {
+    ring().sync();
+}
+
+size_t Logger::dropped() {
+    return ring().dropped();
+}
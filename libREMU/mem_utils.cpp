@@ -1,6 +1,11 @@
 #include "mem_utils.h"
 #include "bitmap_tree.h"
+#include "ecc.h"
+#include "trial_guard.h"
+#include "logger.h"
+#include "stats.h"
 #include <fstream>
+#include <sstream>
 #include <unistd.h>
 #include <sys/types.h>
 #include <iostream>
@@ -13,7 +18,11 @@
 #include <cxxabi.h>
 #include <cstdint>
 #include <memory>
-#include <regex>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <sys/stat.h>
+#include <algorithm>
 
 bool Pmem::hasP(uintptr_t Paddr) const {return Paddr >= s_Paddr && Paddr <= t_Paddr;}
 
@@ -37,28 +46,28 @@ Vmem Pmem::VtoP(uintptr_t Vaddr) const {
     return {Vaddr, paddr};
 }
 
-MemUtils::MemUtils(size_t dram_capacity_gb) : DRAM_CAPACITY_GB(dram_capacity_gb) {
+MemUtils::MemUtils(size_t dram_capacity_gb, SystemSource* source) : DRAM_CAPACITY_GB(dram_capacity_gb), source(source) {
+    if (source == nullptr) {
+        own_source.reset(new ProcSource());
+        this->source = own_source.get();
+    }
     if(!parse_iomem()){
         std::cerr << "Failed to parse iomem" << std::endl;
         throw std::runtime_error("Failed to parse iomem");
     }
 }
 
-std::vector<uintptr_t> randomError(int bitnum, int seed, uintptr_t start, uintptr_t end){
-    std::vector<uintptr_t> errors;
-    std::mt19937 rng(seed);
-    std::uniform_int_distribution<uintptr_t> dist(start, end);
-    while(bitnum--){
-        errors.push_back(dist(rng));
-    }
-    return errors;
+void MemUtils::attach(pid_t pid) {
+    target_pid = pid;
+    applier = FlipApplier(pid ? FlipApplier::Mode::Remote : FlipApplier::Mode::Direct, pid);
 }
+
 uintptr_t random_uintptr(int seed, uintptr_t start, uintptr_t end) {
     std::mt19937 rng(seed);
     std::uniform_int_distribution<uintptr_t> dist(start, end);
     return dist(rng);
 }
-std::vector<Vmem> MemUtils::get_error_Va_tree(MemUtils* self, uintptr_t Vaddr, size_t size, std::ofstream& logfile, int error_bit_num, int flip_bit, const std::string& mapping, const std::map<int,int>& errorMap) {
+std::vector<Vmem> MemUtils::get_error_Va_tree(MemUtils* self, uintptr_t Vaddr, size_t size, std::ofstream& logfile, int error_bit_num, int flip_bit, const std::string& mapping, const std::map<int,int>& errorMap, size_t* applied) {
     uintptr_t page_size = sysconf(_SC_PAGE_SIZE);
     std::vector<Pmem> pmems = getPmems(self, Vaddr, size, page_size);
     //读配置文件，创建DRAM层级、翻译规则和树
@@ -78,87 +87,79 @@ std::vector<Vmem> MemUtils::get_error_Va_tree(MemUtils* self, uintptr_t Vaddr, s
         std::vector<uintptr_t> errors;
         errors.reserve(cnt*num);
         errors = bt_tree.getError(num, cnt, 0.8, 0.2, 0);
-        std::cout<<"error daddr: ";
-        for(auto err:errors)std::cout<<std::hex<<err<<" ";
-        std::cout<<std::endl;
+        for(auto err:errors) REMU_LOG(Debug, nullptr, "error daddr: {x}", err);
         std::vector<Vmem> Verr;
         Verr.reserve(cnt*num);
         Verr=getValidVA_in_pa(self, errors, pmems);  
-        std::cout<<"error vaddr: ";
-        for(auto err:Verr)std::cout<<std::hex<<err.vaddr<<" "<<std::hex<<err.paddr<<std::endl;
-        std::cout<<std::endl;
+        for(auto err:Verr) REMU_LOG(Debug, nullptr, "error vaddr: {x} {x}", err.vaddr, err.paddr);
         total_Verr.insert(total_Verr.end(), Verr.begin(), Verr.end());
     }
     
     for(const auto& vmem: total_Verr){
-        logfile << "Error PA: " << std::hex << vmem.paddr << ", mapVA: " <<std::hex << vmem.vaddr << std::endl;
+        REMU_LOG(Info, &logfile, "Error PA: {x}, mapVA: {x}", vmem.paddr, vmem.vaddr);
     } 
 
-    for(auto vmem : total_Verr){
-        unsigned char* byteAddress = reinterpret_cast<unsigned char*>(vmem.vaddr);
-        std::bitset<8> bitsBefore(*byteAddress);
-        *byteAddress ^= 1 << flip_bit;
-        std::bitset<8> bitsAfter(*byteAddress); 
-        // logfile << bitsBefore << " -> " << bitsAfter << std::endl; // Print the binary representation
-    }    
+    const size_t changed = inject(self, total_Verr, flip_bit);
+    if (applied != nullptr) *applied = changed;
     return total_Verr;
 }
 
 std::vector<Vmem> MemUtils::get_error_Va(MemUtils* self, uintptr_t Vaddr, size_t size, std::ofstream& logfile, int error_bit_num, int flip_bit, 
-    const std::string& cfg, const std::string& mapping, const std::map<int,int>& errorMap) {
+    const std::string& cfg, const std::string& mapping, const std::map<int,int>& errorMap, size_t* applied) {
     uintptr_t page_size = sysconf(_SC_PAGE_SIZE);
     std::vector<Pmem> pmems = getPmems(self, Vaddr, size, page_size);
     if (!logfile.is_open()) {
         std::cerr << "Failed to open log file" << std::endl;
         return {};
     }
-    logfile << "Pmems details:" << std::endl;
+    REMU_LOG(Debug, &logfile, "Pmems details:");
     for (const auto& pmem : pmems) {
-        logfile << "Start PA: " << std::hex << pmem.s_Paddr
-                  << ", End PA: " << std::hex << pmem.t_Paddr
-                  << ", Size: " << std::dec << pmem.size
-                  << ", Start DA: " << std::hex << pmem.s_Daddr
-                  << ", End DA: " << std::hex << pmem.t_Daddr
-                  << ", Base: " << std::hex << pmem.base
-                  << ", Start VA: " << std::hex << pmem.s_Vaddr
-                  << ", End VA: " << std::hex << pmem.t_Vaddr
-                  << ", Bias: " << std::dec << pmem.bias << std::endl;
+        REMU_LOG(Debug, &logfile, "Start PA: {x}, End PA: {x}, Size: {}, Start DA: {x}, End DA: {x}, Base: {x}, Start VA: {x}, End VA: {x}, Bias: {}",
+                 pmem.s_Paddr, pmem.t_Paddr, pmem.size, pmem.s_Daddr, pmem.t_Daddr, pmem.base, pmem.s_Vaddr, pmem.t_Vaddr, pmem.bias);
         // break;
     }
 
     uintptr_t min_Daddr=getMinDA_in_pmems(pmems);
     uintptr_t max_Daddr=getMaxDA_in_pmems(pmems);
-    logfile << "min-max: " << std::hex << min_Daddr << " " << max_Daddr  <<std::endl;
-    std::cout << "min-max: " << std::hex << min_Daddr << " " << max_Daddr  <<std::endl;
+    REMU_LOG(Info, &logfile, "min-max: {x} {x}", min_Daddr, max_Daddr);
+    REMU_LOG(Info, nullptr, "min-max: {x} {x}", min_Daddr, max_Daddr);
 
     float portion=(float)(size)/(float)(max_Daddr-min_Daddr);
-    std::cout<<" size / all range : "<<portion<<std::endl;
+    REMU_LOG(Info, nullptr, " size / all range : {}", portion);
     // REMU
     std::random_device rd;
     std::vector<Vmem> total_Verr;
     int getcnt=0;
     int duplicnt=0;
-    ErrorBitmap<LPDDR4> error_bitmap(min_Daddr, max_Daddr, page_size);
-    error_bitmap.REMU(cfg, mapping);
-    std::cout << "errors: ";
+    std::unique_ptr<ErrorBitmapBase> error_bitmap;
+    {
+        REMU_TIMED(TreeBuild);
+        error_bitmap = ErrorBitmapBase::create(cfg, min_Daddr, max_Daddr, page_size);
+        error_bitmap->REMU(cfg, mapping);
+    }
     for (const auto& pair : errorMap) {
         int totalcnt=pair.second;
         int bitnum=pair.first;
-        std::cout << std::dec <<bitnum << "-" << totalcnt << " ";
+        REMU_LOG(Info, nullptr, "errors: {}-{}", bitnum, totalcnt);
         for(int i=0;i<totalcnt;i++){
             while(true){
                 assert(getcnt <= 5000000 && "Time Out!");
                 // if(getcnt>500)break;
                 int seed = rd();
-                //std::vector<uintptr_t> errors = error_bitmap.calculateError(bitnum, seed);    
-                std::vector<uintptr_t> errors = randomError(bitnum, seed, min_Daddr, max_Daddr);    
+                std::vector<uintptr_t> errors;
+                {
+                    REMU_TIMED(Sample);
+                    errors = error_bitmap->calculateError(bitnum, seed);
+                }
+                REMU_COUNT(Sampled, errors.size());
 
                 std::vector<Vmem> Verr;
                 Verr=getValidVA_in_pa(self, errors, pmems);  
                 //print Verr
                 //std::cout<<"errors size:"<<errors.size()<<", Verr size: "<<Verr.size()<<std::endl;
 
-                if(Verr.size()==errors.size()){
+                // clusters clipped by the mapped range come back short and are redrawn
+                if(errors.size()==static_cast<size_t>(bitnum) && Verr.size()==errors.size()){
                     bool isDuplicate = false;
                     for (const auto& vmem : Verr) {
                         auto it = std::find_if(total_Verr.begin(), total_Verr.end(),
@@ -173,31 +174,91 @@ std::vector<Vmem> MemUtils::get_error_Va(MemUtils* self, uintptr_t Vaddr, size_t
                     if (!isDuplicate) {
                         total_Verr.insert(total_Verr.end(), Verr.begin(), Verr.end());
                         break;
-                    }else duplicnt++;
+                    }else{
+                        duplicnt++;
+                        REMU_COUNT(Duplicates, Verr.size());
+                    }
                 }else{
                     getcnt++;
+                    REMU_COUNT(Retries, 1);
                 }     
             }
         }
     }
-    std::cout << std::dec << getcnt <<" tried, "<<std::dec <<duplicnt<<" duplicated, "<<std::dec << total_Verr.size() << " valid\n";
+    REMU_LOG(Info, nullptr, "{} tried, {} duplicated, {} valid", getcnt, duplicnt, total_Verr.size());
 
     for(const auto& vmem: total_Verr){
-        logfile << "Error PA: " << std::hex << vmem.paddr << ", mapVA: " <<std::hex << vmem.vaddr << std::endl;
+        REMU_LOG(Info, &logfile, "Error PA: {x}, mapVA: {x}", vmem.paddr, vmem.vaddr);
         // break;
     } 
     // logfile << "\n InjectFault details: "<<std::endl;
-    for(auto vmem : total_Verr){
-        unsigned char* byteAddress = reinterpret_cast<unsigned char*>(vmem.vaddr);
-        std::bitset<8> bitsBefore(*byteAddress);
-        *byteAddress ^= 1 << flip_bit;
-        std::bitset<8> bitsAfter(*byteAddress); 
-        // logfile << bitsBefore << " -> " << bitsAfter << std::endl; // Print the binary representation
-    }
+    const size_t changed = inject(self, total_Verr, flip_bit);
+    if (applied != nullptr) *applied = changed;
     // std::cout << std::endl;
     return total_Verr;
 }
 
+std::vector<Vflip> MemUtils::to_flips(const std::vector<Vmem>& errors, int flip_bit) {
+    std::vector<Vflip> flips;
+    flips.reserve(errors.size());
+    for (const auto& vmem : errors) {
+        flips.push_back({vmem.vaddr, vmem.paddr, static_cast<uint8_t>(1 << flip_bit)});
+    }
+    std::sort(flips.begin(), flips.end(), [](const Vflip& a, const Vflip& b) { return a.vaddr < b.vaddr; });
+    // two errors on the same bit cancel out, keep one entry per byte
+    size_t n = 0;
+    for (size_t i = 0; i < flips.size(); i++) {
+        if (n > 0 && flips[n-1].vaddr == flips[i].vaddr) flips[n-1].mask ^= flips[i].mask;
+        else flips[n++] = flips[i];
+    }
+    REMU_COUNT(Duplicates, flips.size() - n);
+    flips.resize(n);
+    return flips;
+}
+
+size_t MemUtils::inject(MemUtils* self, const std::vector<Vmem>& errors, int flip_bit) {
+    std::vector<Vflip> flips = to_flips(errors, flip_bit);
+    REMU_COUNT(Injections, 1);
+    REMU_COUNT(Planned, flips.size());
+    if (self->ecc != nullptr) {
+        REMU_TIMED(Ecc);
+        // the model's counters are cumulative, this call's share is logged
+        const EccModel::Stats before = self->ecc->stats();
+        flips = self->ecc->filter(flips);
+        const EccModel::Stats& after = self->ecc->stats();
+        REMU_LOG(Info, nullptr, "ecc: {} words, {}/{} bits applied", after.words - before.words,
+                 after.residual_bits - before.residual_bits, after.planned_bits - before.planned_bits);
+        for (int i = 0; i < int(EccModel::Outcome::MAX); i++) {
+            REMU_LOG(Info, nullptr, "ecc: {} {}", after.outcome[i] - before.outcome[i], EccModel::outcome_str(EccModel::Outcome(i)));
+        }
+    }
+    size_t applied;
+    std::vector<Vflip> failed;
+    {
+        REMU_TIMED(Apply);
+        applied = self->applier.apply(flips, failed);
+    }
+    REMU_COUNT(Applied, applied);
+    if (!failed.empty()) {
+        REMU_LOG(Warn, nullptr, "{} of {} flips were not applied.", failed.size(), flips.size());
+        // journal only the written bytes, reverting the others would flip them instead;
+        // `failed` is sorted by vaddr, the ECC residue is sorted by paddr
+        std::sort(flips.begin(), flips.end(), [](const Vflip& a, const Vflip& b) { return a.vaddr < b.vaddr; });
+        size_t n = 0;
+        size_t f = 0;
+        for (size_t i = 0; i < flips.size(); i++) {
+            while (f < failed.size() && failed[f].vaddr < flips[i].vaddr) f++;
+            if (f < failed.size() && failed[f].vaddr == flips[i].vaddr) f++;
+            else flips[n++] = flips[i];
+        }
+        flips.resize(n);
+    }
+    if (self->guard != nullptr) {
+        self->guard->record(flips, self->applier);
+    }
+    return applied;
+}
+
 //random error
 std::vector<uintptr_t> MemUtils::get_random_error_Va(uintptr_t Vaddr, size_t size, std::ofstream& logfile, int error_bit_num, int flip_bit) {
     std::vector<uintptr_t> total_Verr;
@@ -210,9 +271,9 @@ std::vector<uintptr_t> MemUtils::get_random_error_Va(uintptr_t Vaddr, size_t siz
             total_Verr.push_back(vmem);
         }
     }
-    std::cout << std::dec << total_Verr.size() << " valid\n";
+    REMU_LOG(Info, nullptr, "{} valid", total_Verr.size());
     for(const auto& vmem: total_Verr){
-        logfile << "Error VA: " <<std::hex << vmem << std::endl;
+        REMU_LOG(Info, &logfile, "Error VA: {x}", vmem);
         break;
         // std::cout << "Error VA: " <<std::hex << vmem << std::endl;
     } 
@@ -244,71 +305,230 @@ std::string MemUtils::human_readable(size_t bytes) {
     }
     return std::string(buffer);
 }
+// write `content` to `path` through a temporary file in the same directory, so concurrent
+// writers never leave a torn file behind
+static bool write_atomically(const std::string& path, const char* content, size_t size) {
+    std::string tmp = path + ".XXXXXX";
+    int fd = mkstemp(&tmp[0]);
+    if (fd < 0) return false;
+    bool ok = true;
+    for (size_t done = 0; ok && done < size;) {
+        ssize_t n = write(fd, content + done, size - done);
+        if (n < 0 && errno == EINTR) continue;
+        ok = n > 0;
+        if (ok) done += size_t(n);
+    }
+    fchmod(fd, 0644);
+    ok = close(fd) == 0 && ok;
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+        unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
 // write the lookup table to a file
 bool MemUtils::write_pd_lut(const std::string &filename) {
-    std::ofstream ofs(filename);
-    if (!ofs.is_open())
-        return false;
+    std::ostringstream ofs;
     ofs << "# pa_start pa_end da_base size" << std::endl;
     for (const auto &seg : MemUtils::pdmapper) {
         uintptr_t seg_size = seg.pa_end - seg.pa_start + 1;
         ofs << "0x" << std::hex << seg.pa_start << " 0x" << seg.pa_end
             << " 0x" << seg.da_base << " " << MemUtils::human_readable(seg_size) << std::dec << std::endl;
     }
-    ofs.close();
+    std::string table = ofs.str();
+    return write_atomically(filename, table.data(), table.size());
+}
+
+// the whole file in one string, read with read(2) (no stream setup)
+static bool read_file(const char* path, std::string& content) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    content.clear();
+    char buf[8192];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) != 0) {
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            close(fd);
+            return false;
+        }
+        content.append(buf, size_t(n));
+    }
+    close(fd);
     return true;
 }
-bool MemUtils::parse_iomem() {
-    std::ifstream iomem("/proc/iomem");
-    if (!iomem.is_open()) {
-        std::cerr << "[Error] Cannot open /proc/iomem, please run as root." << std::endl;
-        return false;
+
+namespace {
+
+/**
+ * The segment table cache: this header and `segments` Pseg entries. Only the machine's own
+ * /proc/iomem is cached, and the table is valid for the boot and the iomem text it was built
+ * from (a memory hotplug changes the text).
+ */
+struct PdCacheHeader {
+    char magic[8];       // "REMUPDSG"
+    uint32_t version;
+    uint32_t segments;
+    char boot_id[40];    // /proc/sys/kernel/random/boot_id
+    uint64_t iomem_size; // length of the iomem text
+    uint64_t iomem_hash; // FNV-1a of the iomem text
+};
+
+const uint32_t PD_CACHE_VERSION = 3;
+const size_t PD_CACHE_MAX_SEGMENTS = 1024;
+
+// $REMU_CACHE_DIR, else $XDG_CACHE_HOME/remu, else ~/.cache/remu; empty when there is none
+std::string cache_dir() {
+    if (const char* dir = std::getenv("REMU_CACHE_DIR")) return dir;
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME")) {
+        if (*xdg) return std::string(xdg) + "/remu";
+    }
+    if (const char* home = std::getenv("HOME")) return std::string(home) + "/.cache/remu";
+    return "";
+}
+
+uint64_t fnv1a(const std::string& text) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (unsigned char c : text) {
+        h ^= c;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+// mkdir -p
+bool make_dirs(const std::string& path) {
+    for (size_t slash = path.find('/', 1); ; slash = path.find('/', slash + 1)) {
+        std::string prefix = path.substr(0, slash);
+        if (mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST) return false;
+        if (slash == std::string::npos) return true;
+    }
+}
+
+bool ieq_prefix(const char* p, const char* end, const char* word) {
+    for (; *word; p++, word++) {
+        if (p == end || std::tolower(static_cast<unsigned char>(*p)) != *word) return false;
     }
-    std::string line;
-    std::regex range_regex(R"(^\s*([0-9a-fA-F]+)-([0-9a-fA-F]+)\s*:\s*(.*)$)");
-    std::regex keyword_regex(R"(reserved|system ram)", std::regex_constants::icase);
-    struct Range {
-        uintptr_t start;
-        uintptr_t end;
+    return true;
+}
+
+// "  start-end : description" in hex; false for any other line
+bool parse_iomem_line(const char* p, const char* end, uintptr_t& start, uintptr_t& last, bool& dram) {
+    while (p != end && (*p == ' ' || *p == '\t')) p++;
+    auto hex = [&](uintptr_t& v) {
+        const char* first = p;
+        v = 0;
+        for (; p != end; p++) {
+            int d = std::isdigit(static_cast<unsigned char>(*p)) ? *p - '0'
+                  : (*p >= 'a' && *p <= 'f') ? *p - 'a' + 10
+                  : (*p >= 'A' && *p <= 'F') ? *p - 'A' + 10 : -1;
+            if (d < 0) break;
+            v = (v << 4) | uintptr_t(d);
+        }
+        return p != first;
     };
-    std::vector<Range> merged_ranges;
-    while (std::getline(iomem, line)) {
-        std::smatch match;
-        if (std::regex_match(line, match, range_regex)) {
-            std::string desc = match[3].str();
-            if (std::regex_search(desc, keyword_regex)) {
-                uintptr_t start = std::stoull(match[1].str(), nullptr, 16);
-                uintptr_t end = std::stoull(match[2].str(), nullptr, 16);
+    if (!hex(start) || p == end || *p++ != '-' || !hex(last)) return false;
+    while (p != end && (*p == ' ' || *p == '\t')) p++;
+    if (p == end || *p++ != ':') return false;
+    dram = false;
+    for (; p != end && !dram; p++) dram = ieq_prefix(p, end, "reserved") || ieq_prefix(p, end, "system ram");
+    return true;
+}
+
+} // namespace
+
+bool MemUtils::parse_iomem() {
+    REMU_TIMED(Iomem);
+    pdmapper.clear();
+
+    std::string text;
+    if (!source->iomem(text)) return false;
+
+    // the table cached for this boot and this iomem text is used without parsing it
+    // (REMU_CACHE_DIR= turns the cache off). Other sources are not cached.
+    std::string boot_id, dir, cache;
+    const uint64_t hash = fnv1a(text);
+    if (dynamic_cast<ProcSource*>(source) != nullptr) {
+        dir = cache_dir();
+        if (!dir.empty() && read_file("/proc/sys/kernel/random/boot_id", boot_id) &&
+            boot_id.size() < sizeof(PdCacheHeader::boot_id)) {
+            cache = dir + "/pd_segments";
+        }
+    }
+    if (!cache.empty()) {
+        std::vector<char> buf(sizeof(PdCacheHeader) + PD_CACHE_MAX_SEGMENTS * sizeof(Pseg));
+        int fd = open(cache.c_str(), O_RDONLY | O_CLOEXEC);
+        ssize_t n = fd < 0 ? -1 : read(fd, buf.data(), buf.size());
+        if (fd >= 0) close(fd);
+        PdCacheHeader head;
+        if (n >= ssize_t(sizeof(head))) {
+            std::memcpy(&head, buf.data(), sizeof(head));
+            head.boot_id[sizeof(head.boot_id) - 1] = '\0';
+            if (std::memcmp(head.magic, "REMUPDSG", 8) == 0 && head.version == PD_CACHE_VERSION &&
+                boot_id.compare(0, std::string::npos, head.boot_id) == 0 &&
+                head.iomem_size == text.size() && head.iomem_hash == hash &&
+                head.segments > 0 && size_t(n) == sizeof(head) + head.segments * sizeof(Pseg)) {
+                pdmapper.resize(head.segments);
+                std::memcpy(pdmapper.data(), buf.data() + sizeof(head), head.segments * sizeof(Pseg));
+            }
+        }
+    }
+
+    if (pdmapper.empty()) {
+        struct Range {
+            uintptr_t start;
+            uintptr_t end;
+        };
+        std::vector<Range> merged_ranges;
+        for (size_t pos = 0; pos < text.size();) {
+            size_t eol = text.find('\n', pos);
+            if (eol == std::string::npos) eol = text.size();
+            uintptr_t start, end;
+            bool dram;
+            if (parse_iomem_line(text.data() + pos, text.data() + eol, start, end, dram) && dram) {
                 if (!merged_ranges.empty() && start <= merged_ranges.back().end + 1) {
                     merged_ranges.back().end = std::max(merged_ranges.back().end, end);
                 } else {
                     merged_ranges.push_back({start, end});
                 }
             }
+            pos = eol + 1;
+        }
+        if (merged_ranges.empty() || merged_ranges[0].end <= merged_ranges[0].start) {
+            std::cerr << "[Error] Not found any DRAM regions in /proc/iomem, please run as root." << std::endl;
+            return false;
         }
-    }
-    iomem.close();
-    if (merged_ranges.empty() || merged_ranges[0].end <= merged_ranges[0].start) {
-        std::cerr << "[Error] Not found any DRAM regions in /proc/iomem, please run as root." << std::endl;
-        return false;
-    }
 
-    // every segment records the physical address range and the starting address after mapping
-    uintptr_t current_da_base = 0;
-    uintptr_t total_size = 0;
-    uintptr_t seg_size = 0;
-    for (const auto &r : merged_ranges) {
-        seg_size = r.end - r.start + 1;
-        total_size += seg_size;
-        Pseg seg;
-        seg.pa_start = r.start;
-        seg.pa_end = r.end;
-        current_da_base += r.start;
-        seg.da_base = current_da_base;
-        current_da_base -= (r.end+1);
-        pdmapper.push_back(seg);
+        // every segment records the physical address range and the starting address after mapping
+        uintptr_t current_da_base = 0;
+        for (const auto &r : merged_ranges) {
+            Pseg seg;
+            seg.pa_start = r.start;
+            seg.pa_end = r.end;
+            current_da_base += r.start;
+            seg.da_base = current_da_base;
+            current_da_base -= (r.end+1);
+            pdmapper.push_back(seg);
+        }
+
+        if (!cache.empty() && pdmapper.size() <= PD_CACHE_MAX_SEGMENTS) {
+            PdCacheHeader head;
+            std::memset(&head, 0, sizeof(head));
+            std::memcpy(head.magic, "REMUPDSG", 8);
+            head.version = PD_CACHE_VERSION;
+            head.segments = uint32_t(pdmapper.size());
+            std::memcpy(head.boot_id, boot_id.data(), boot_id.size());
+            head.iomem_size = text.size();
+            head.iomem_hash = hash;
+            std::string content(reinterpret_cast<const char*>(&head), sizeof(head));
+            content.append(reinterpret_cast<const char*>(pdmapper.data()), pdmapper.size() * sizeof(Pseg));
+            if (make_dirs(dir)) write_atomically(cache, content.data(), content.size()); // best effort
+        }
     }
 
+    uintptr_t total_size = 0;
+    for (const auto &seg : pdmapper) total_size += seg.pa_end - seg.pa_start + 1;
     uintptr_t dram_capacity_bytes = DRAM_CAPACITY_GB;
     dram_capacity_bytes <<= 30; // GB -> bytes
 
@@ -317,8 +537,11 @@ bool MemUtils::parse_iomem() {
                   << ") is less than the input DRAM_CAPACITY (" << MemUtils::human_readable(dram_capacity_bytes) << ")." << std::endl;
     }
 
-    if (!write_pd_lut("pd_lut")) {
-        std::cerr << "[Error] Failed to write the lookup table to file." << std::endl;
+    // the lookup table is only dumped on request
+    if (const char* lut = std::getenv("REMU_PD_LUT")) {
+        if (!write_pd_lut(lut)) {
+            std::cerr << "[Error] Failed to write the lookup table to " << lut << "." << std::endl;
+        }
     }
     return true;
 }
@@ -359,6 +582,7 @@ uintptr_t MemUtils::D2P(uintptr_t da) {
 }
 
 std::vector<Pmem> MemUtils::getPmems(MemUtils* self, uintptr_t Vaddr, size_t size, uintptr_t page_size) {
+    REMU_TIMED(Pagemap);
     // std::cout << "page_size: " << page_size <<std::endl;
     uintptr_t currentVaddr = Vaddr, currentPaddr;
     uintptr_t endVaddr = Vaddr + size;
@@ -368,25 +592,32 @@ std::vector<Pmem> MemUtils::getPmems(MemUtils* self, uintptr_t Vaddr, size_t siz
     Pmem currentPmem;
     bool firstPmem = true;
 
-    pid_t pid = getpid();
-    std::string pagemap_path = "/proc/" + std::to_string(pid) + "/pagemap";
-    int pagemap_fd = open(pagemap_path.c_str(), O_RDONLY);
-    if (pagemap_fd == -1) {
-        std::cerr << "Error opening " << pagemap_path << ": " << strerror(errno) << std::endl;
-    }
+    pid_t pid = self->target_pid ? self->target_pid : getpid();
+    // pagemap entries are read in batches of up to 512 pages
+    const size_t batch_pages = 512;
+    std::vector<uint64_t> entries(batch_pages);
+    uintptr_t batch_first = 0, batch_count = 0;
+    const uintptr_t last_page = (endVaddr - 1) / page_size;
     unsigned long long entry=0, pfn=0;
-    size_t offset=0;
     ssize_t read_bytes;
 
     while (currentVaddr < endVaddr) {
         //  getPhysicalAddress  currentVaddr --> currentPaddr
-        offset = (currentVaddr / page_size) * sizeof(unsigned long long);
-        read_bytes = pread(pagemap_fd, &entry, sizeof(entry), offset);
-        if (read_bytes < 0) {
-            std::cerr << "Failed to read pagemap entry: " << strerror(errno) << std::endl; close(pagemap_fd);
-        } else if (read_bytes != sizeof(entry)) {
-            std::cerr << "Incomplete read from pagemap: expected " << sizeof(entry) << ", got " << read_bytes << std::endl; close(pagemap_fd); 
+        uintptr_t page = currentVaddr / page_size;
+        if (page < batch_first || page >= batch_first + batch_count) {
+            batch_first = page;
+            batch_count = std::min<uintptr_t>(batch_pages, last_page - page + 1);
+            read_bytes = self->source->pagemap(pid, page, batch_count, entries.data());
+            REMU_COUNT(Pages, batch_count);
+            if (read_bytes < 0) {
+                std::cerr << "Failed to read pagemap entry: " << strerror(errno) << std::endl;
+                read_bytes = 0;
+            } else if (read_bytes != static_cast<ssize_t>(batch_count * sizeof(entry))) {
+                std::cerr << "Incomplete read from pagemap: expected " << batch_count * sizeof(entry) << ", got " << read_bytes << std::endl;
+            }
+            std::fill(entries.begin() + read_bytes / sizeof(entry), entries.begin() + batch_count, 0ULL);
         }
+        entry = entries[page - batch_first];
         if ((entry & (1ULL << 63)) == 0) { std::cerr<< "Page not present in memory." << std::endl;}
         pfn = entry & ((1ULL << 55) - 1);
         assert((1<<12) == page_size);
@@ -425,7 +656,7 @@ std::vector<Pmem> MemUtils::getPmems(MemUtils* self, uintptr_t Vaddr, size_t siz
         pmems.push_back(currentPmem);
     }
 
-    close(pagemap_fd);
+    REMU_COUNT(Fragments, pmems.size());
     for(auto &pmem: pmems){
         pmem.s_Daddr = self->P2D(pmem.s_Paddr, pmem.base);
         pmem.t_Daddr = pmem.s_Daddr + pmem.size-1;
@@ -461,6 +692,7 @@ Pmem MemUtils::get_block_in_pmems(MemUtils* self, uintptr_t Vaddr, size_t size,
 }
 
 std::vector<Vmem> MemUtils::getValidVA_in_pa(MemUtils* self, const std::vector<uintptr_t>& daddrs, const std::vector<Pmem>& pmems){
+    REMU_TIMED(Translate);
     std::vector<Vmem> vmems;
     for (uintptr_t daddr : daddrs) { 
         uintptr_t paddr = self->D2P(daddr);
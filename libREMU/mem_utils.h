@@ -4,7 +4,10 @@
 #include <vector>
 #include <cstdint>
 #include <string>
+#include <memory>
 #include "error_bitmap.h"
+#include "flip_apply.h"
+#include "system_source.h"
 
 struct Vmem {
     uintptr_t vaddr; /**< The virtual address. */  
@@ -48,6 +51,9 @@ struct Pseg {
     size_t da_base;     
 };
 
+class EccModel;
+class TrialGuard;
+
 class MemUtils {
     /**
      * The utils of injecting radiation-induced bit-flip errors.
@@ -55,12 +61,23 @@ class MemUtils {
 public:
     /**
      * Constructs a MemUtils instance and initializes the DRAM simulator.
+     * The layout and the pagemap come from `source` (not owned), /proc by default.
     */
 
-    MemUtils(size_t dram_capacity_gb);
+    explicit MemUtils(size_t dram_capacity_gb, SystemSource* source = nullptr);
 
     std::vector<Pseg> pdmapper; // mapping segments (physical address range and mapped base address)
     size_t DRAM_CAPACITY_GB;             // DRAM capacity in GB
+    EccModel* ecc = nullptr;             // optional ECC stage between planning and application (not owned)
+    FlipApplier applier;                 // how flips are written (Direct by default, ProcMem/Mprotect/Auto for read-only mappings)
+    pid_t target_pid = 0;                // process whose pagemap is translated, 0 for the calling process
+    TrialGuard* guard = nullptr;         // optional journal of applied flips, reverted after each trial (not owned)
+    SystemSource* source;                // physical layout and V->P translation (ProcSource unless given)
+
+    /**
+     * Inject into another process: translate through /proc/<pid>/pagemap and write with process_vm_writev.
+    */
+    void attach(pid_t pid);
     
     bool parse_iomem();
     static std::string human_readable(size_t bytes);
@@ -68,8 +85,9 @@ public:
     uintptr_t P2D(uintptr_t pa, size_t &base);
     uintptr_t D2P(uintptr_t da);
 
-    static std::vector<Vmem> get_error_Va(MemUtils* self, uintptr_t Vaddr, size_t size, std::ofstream& logfile, int error_bit_num, int flip_bit, const std::string& cfg, const std::string& mapping, const std::map<int,int>& errorMap);
-    static std::vector<Vmem> get_error_Va_tree(MemUtils* self, uintptr_t Vaddr, size_t size, std::ofstream& logfile, int error_bit_num, int flip_bit, const std::string& mapping, const std::map<int,int>& errorMap);
+    // both return the planned errors; `applied` (if given) receives the number of bytes the applier changed
+    static std::vector<Vmem> get_error_Va(MemUtils* self, uintptr_t Vaddr, size_t size, std::ofstream& logfile, int error_bit_num, int flip_bit, const std::string& cfg, const std::string& mapping, const std::map<int,int>& errorMap, size_t* applied = nullptr);
+    static std::vector<Vmem> get_error_Va_tree(MemUtils* self, uintptr_t Vaddr, size_t size, std::ofstream& logfile, int error_bit_num, int flip_bit, const std::string& mapping, const std::map<int,int>& errorMap, size_t* applied = nullptr);
 
     static std::vector<uintptr_t> get_random_error_Va(uintptr_t Vaddr, size_t size, std::ofstream& logfile, int error_bit_num, int flip_bit);
     /**
@@ -77,8 +95,21 @@ public:
     */
     static Pmem get_block_in_pmems(MemUtils* self, uintptr_t Vaddr, size_t size, size_t bias);
 
+    /**
+     * Convert planned error addresses to per-byte flips (flips on the same byte are merged).
+    */
+    static std::vector<Vflip> to_flips(const std::vector<Vmem>& errors, int flip_bit);
+
 private:
-    
+    std::unique_ptr<SystemSource> own_source;
+    friend class RemuBench; // tools/remu_bench.cpp times the translation steps below
+
+    /**
+     * Pass the planned flips through the ECC stage (if any) and apply the residue; returns the
+     * number of bytes changed.
+    */
+    static size_t inject(MemUtils* self, const std::vector<Vmem>& errors, int flip_bit);
+
     /**
      * Get a list of pairs of physical blocks and virual blocks.
     */
@@ -0,0 +1,384 @@
+#include "results_store.h"
+#include <stdexcept>
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const char results_magic[8] = {'R', 'E', 'M', 'U', 'R', 'S', 'L', 'T'};
+static const char block_magic[4] = {'R', 'B', 'L', 'K'};
+static const char trailer_magic[8] = {'R', 'E', 'M', 'U', 'R', 'I', 'D', 'X'};
+
+static size_t align8(size_t bytes) { return (bytes + 7) & ~size_t(7); }
+
+const char* TrialRecord::outcome_str(Outcome outcome) {
+    switch (outcome) {
+        case Outcome::Completed: return "completed";
+        case Outcome::Masked: return "masked";
+        case Outcome::SDC: return "sdc";
+        case Outcome::Crashed: return "crashed";
+        case Outcome::Hung: return "hung";
+        default: return "unknown";
+    }
+}
+
+TrialRecord::Outcome TrialRecord::parse_outcome(const std::string& name) {
+    for (int i = 0; i < int(Outcome::MAX); i++) {
+        if (name == outcome_str(Outcome(i))) return Outcome(i);
+    }
+    throw std::invalid_argument("Unknown trial outcome " + name);
+}
+
+size_t ResultsFile::column_offset(Column column, size_t n, size_t m) {
+    // widest columns first, each padded to 8 bytes
+    size_t sizes[int(Column::MAX)] = {
+        8 * n, 8 * n, 8 * n,                 // Seed, Metric, Seconds
+        4 * n, 4 * n, 4 * (n + 1), n,        // MapId, Flips, PlanOffset, Outcome
+        8 * m, 8 * m, m                      // PlanVaddr, PlanPaddr, PlanMask
+    };
+    size_t offset = 0;
+    for (int c = 0; c < int(column); c++) offset += align8(sizes[c]);
+    return offset;
+}
+
+ResultsWriter::ResultsWriter(const std::string& filename, uint32_t block_trials)
+    : filename(filename), out(nullptr), fd(-1), block_trials(std::max<uint32_t>(block_trials, 1)),
+      offset(0), trials(0), stream_buffer(1 << 20)
+{
+    fd = open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd == -1) {
+        throw std::runtime_error("Cannot open results " + filename + ": " + strerror(errno));
+    }
+    if (flock(fd, LOCK_EX) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Cannot lock results " + filename + ": " + strerror(errno));
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Cannot stat results " + filename + ": " + strerror(errno));
+    }
+
+    size_t length = static_cast<size_t>(st.st_size);
+    if (length == 0) {
+        offset = 0;
+    } else {
+        // continue the file: drop its index (or a torn last block) and append after the last block
+        void* base = length >= sizeof(ResultsFileHeader) ? mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        const ResultsFileHeader* head = static_cast<const ResultsFileHeader*>(base);
+        if (base == MAP_FAILED || std::memcmp(head->magic, results_magic, sizeof(results_magic)) != 0 || head->version != VERSION) {
+            if (base != MAP_FAILED) munmap(base, length);
+            ::close(fd);
+            throw std::runtime_error(filename + ": not a REMU results file");
+        }
+        if (!ResultsFile::read_index(static_cast<const char*>(base), length, index, offset)) {
+            index = ResultsFile::scan(static_cast<const char*>(base), length, offset);
+            std::cerr << "[Warn] " << filename << " was not closed, continuing after its last whole block." << std::endl;
+        }
+        munmap(base, length);
+        for (const ResultsIndexEntry& e : index) trials += e.trials;
+        if (ftruncate(fd, off_t(offset)) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Cannot truncate results " + filename + ": " + strerror(errno));
+        }
+    }
+
+    out = fdopen(fd, "r+b");
+    if (out == nullptr) {
+        ::close(fd);
+        throw std::runtime_error("Cannot open results " + filename + ": " + strerror(errno));
+    }
+    setvbuf(out, stream_buffer.data(), _IOFBF, stream_buffer.size());
+    if (offset == 0) {
+        ResultsFileHeader h;
+        std::memset(&h, 0, sizeof(h));
+        std::memcpy(h.magic, results_magic, sizeof(results_magic));
+        h.version = VERSION;
+        write(&h, sizeof(h));
+        offset = sizeof(h);
+    } else {
+        fseeko(out, off_t(offset), SEEK_SET);
+    }
+    plan_offset.push_back(0);
+}
+
+ResultsWriter::~ResultsWriter() {
+    try {
+        close();
+    } catch (const std::exception& e) {
+        std::cerr << "[Error] " << e.what() << std::endl;
+    }
+}
+
+void ResultsWriter::append(const TrialRecord& record, const std::vector<Vflip>& plan) {
+    if (out == nullptr) {
+        throw std::runtime_error("Results " + filename + " are closed");
+    }
+    seed.push_back(record.seed);
+    metric.push_back(record.metric);
+    seconds.push_back(record.seconds);
+    map_id.push_back(record.map_id);
+    flips.push_back(record.flips);
+    outcome.push_back(uint8_t(record.outcome));
+    for (const Vflip& f : plan) {
+        plan_vaddr.push_back(f.vaddr);
+        plan_paddr.push_back(f.paddr);
+        plan_mask.push_back(f.mask);
+    }
+    plan_offset.push_back(uint32_t(plan_mask.size()));
+    trials++;
+    if (seed.size() >= block_trials || plan_mask.size() >= (1u << 31)) write_block();
+}
+
+void ResultsWriter::write(const void* data, size_t bytes) {
+    if (bytes && std::fwrite(data, 1, bytes, out) != bytes) {
+        throw std::runtime_error("Cannot write results " + filename + ": " + strerror(errno));
+    }
+    static const char zeros[8] = {0};
+    size_t pad = align8(bytes) - bytes;
+    if (pad && std::fwrite(zeros, 1, pad, out) != pad) {
+        throw std::runtime_error("Cannot write results " + filename + ": " + strerror(errno));
+    }
+}
+
+void ResultsWriter::write_block() {
+    if (seed.empty()) return;
+    size_t n = seed.size(), m = plan_mask.size();
+    ResultsBlockHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, block_magic, sizeof(block_magic));
+    h.trials = uint32_t(n);
+    h.plan_entries = m;
+    h.bytes = ResultsFile::column_offset(ResultsFile::Column::MAX, n, m);
+    write(&h, sizeof(h));
+    // in Column order
+    write(seed.data(), n * sizeof(uint64_t));
+    write(metric.data(), n * sizeof(double));
+    write(seconds.data(), n * sizeof(double));
+    write(map_id.data(), n * sizeof(uint32_t));
+    write(flips.data(), n * sizeof(uint32_t));
+    write(plan_offset.data(), (n + 1) * sizeof(uint32_t));
+    write(outcome.data(), n);
+    write(plan_vaddr.data(), m * sizeof(uint64_t));
+    write(plan_paddr.data(), m * sizeof(uint64_t));
+    write(plan_mask.data(), m);
+
+    ResultsIndexEntry e;
+    std::memset(&e, 0, sizeof(e));
+    e.offset = offset;
+    e.trials = uint32_t(n);
+    e.plan_entries = m;
+    index.push_back(e);
+    offset += sizeof(h) + h.bytes;
+
+    seed.clear();
+    metric.clear();
+    seconds.clear();
+    map_id.clear();
+    flips.clear();
+    outcome.clear();
+    plan_vaddr.clear();
+    plan_paddr.clear();
+    plan_mask.clear();
+    plan_offset.assign(1, 0);
+}
+
+void ResultsWriter::flush() {
+    if (out == nullptr) return;
+    write_block();
+    if (std::fflush(out) != 0) {
+        throw std::runtime_error("Cannot write results " + filename + ": " + strerror(errno));
+    }
+}
+
+void ResultsWriter::close() {
+    if (out == nullptr) return;
+    FILE* f = out;
+    try {
+        write_block();
+        ResultsTrailer t;
+        std::memset(&t, 0, sizeof(t));
+        t.index_offset = offset;
+        t.blocks = index.size();
+        t.trials = trials;
+        std::memcpy(t.magic, trailer_magic, sizeof(trailer_magic));
+        write(index.data(), index.size() * sizeof(ResultsIndexEntry));
+        write(&t, sizeof(t));
+    } catch (...) {
+        out = nullptr;
+        std::fclose(f);
+        throw;
+    }
+    out = nullptr;
+    // also releases the lock
+    if (std::fclose(f) != 0) {
+        throw std::runtime_error("Cannot write results " + filename + ": " + strerror(errno));
+    }
+}
+
+bool ResultsFile::read_index(const char* base, size_t length, std::vector<ResultsIndexEntry>& index, uint64_t& end) {
+    if (length < sizeof(ResultsFileHeader) + sizeof(ResultsTrailer)) return false;
+    ResultsTrailer t;
+    std::memcpy(&t, base + length - sizeof(t), sizeof(t));
+    if (std::memcmp(t.magic, trailer_magic, sizeof(trailer_magic)) != 0
+        || t.blocks > length / sizeof(ResultsIndexEntry)
+        || t.index_offset + t.blocks * sizeof(ResultsIndexEntry) + sizeof(t) != length) return false;
+    std::vector<ResultsIndexEntry> entries(t.blocks);
+    std::memcpy(entries.data(), base + t.index_offset, t.blocks * sizeof(ResultsIndexEntry));
+    // every block must lie before the index and agree with its own header
+    uint64_t trials = 0;
+    for (const ResultsIndexEntry& e : entries) {
+        if (e.offset < sizeof(ResultsFileHeader) || e.offset + sizeof(ResultsBlockHeader) > t.index_offset) return false;
+        ResultsBlockHeader h;
+        std::memcpy(&h, base + e.offset, sizeof(h));
+        if (std::memcmp(h.magic, block_magic, sizeof(block_magic)) != 0 || h.trials != e.trials || h.plan_entries != e.plan_entries
+            || h.bytes != column_offset(Column::MAX, h.trials, h.plan_entries) || e.offset + sizeof(h) + h.bytes > t.index_offset) return false;
+        trials += e.trials;
+    }
+    if (trials != t.trials) return false;
+    index.swap(entries);
+    end = t.index_offset;
+    return true;
+}
+
+std::vector<ResultsIndexEntry> ResultsFile::scan(const char* base, size_t length, uint64_t& end) {
+    std::vector<ResultsIndexEntry> index;
+    uint64_t at = sizeof(ResultsFileHeader);
+    while (at + sizeof(ResultsBlockHeader) <= length) {
+        ResultsBlockHeader h;
+        std::memcpy(&h, base + at, sizeof(h));
+        if (std::memcmp(h.magic, block_magic, sizeof(block_magic)) != 0
+            || h.plan_entries > length || h.bytes != column_offset(Column::MAX, h.trials, h.plan_entries)
+            || at + sizeof(h) + h.bytes > length) break;
+        ResultsIndexEntry e;
+        std::memset(&e, 0, sizeof(e));
+        e.offset = at;
+        e.trials = h.trials;
+        e.plan_entries = h.plan_entries;
+        index.push_back(e);
+        at += sizeof(h) + h.bytes;
+    }
+    end = at;
+    return index;
+}
+
+ResultsFile::ResultsFile(const std::string& filename)
+    : base(nullptr), length(0), trials(0), rebuilt(false)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd == -1) {
+        throw std::runtime_error("Cannot open results " + filename + ": " + strerror(errno));
+    }
+    struct stat st;
+    void* mapped = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size >= static_cast<off_t>(sizeof(ResultsFileHeader))) {
+        length = static_cast<size_t>(st.st_size);
+        mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        throw std::runtime_error("Cannot map results " + filename);
+    }
+    base = static_cast<const char*>(mapped);
+    const ResultsFileHeader* head = reinterpret_cast<const ResultsFileHeader*>(base);
+    if (std::memcmp(head->magic, results_magic, sizeof(results_magic)) != 0 || head->version != ResultsWriter::VERSION) {
+        munmap(mapped, length);
+        throw std::runtime_error(filename + ": not a REMU results file");
+    }
+    uint64_t end;
+    if (!read_index(base, length, index, end)) {
+        index = scan(base, length, end);
+        rebuilt = true;
+    }
+    for (const ResultsIndexEntry& e : index) {
+        first.push_back(trials);
+        trials += e.trials;
+    }
+}
+
+ResultsFile::~ResultsFile() {
+    if (base != nullptr) munmap(const_cast<char*>(base), length);
+}
+
+const char* ResultsFile::column(size_t block, Column c) const {
+    const ResultsIndexEntry& e = index[block];
+    return base + e.offset + sizeof(ResultsBlockHeader) + column_offset(c, e.trials, e.plan_entries);
+}
+
+template <typename T>
+std::vector<T> ResultsFile::gather(Column c) const {
+    std::vector<T> values(trials);
+    for (size_t b = 0; b < index.size(); b++) {
+        std::memcpy(values.data() + first[b], column(b, c), index[b].trials * sizeof(T));
+    }
+    return values;
+}
+
+std::vector<uint64_t> ResultsFile::seeds() const { return gather<uint64_t>(Column::Seed); }
+std::vector<double> ResultsFile::metrics() const { return gather<double>(Column::Metric); }
+std::vector<double> ResultsFile::seconds() const { return gather<double>(Column::Seconds); }
+std::vector<uint32_t> ResultsFile::map_ids() const { return gather<uint32_t>(Column::MapId); }
+std::vector<uint32_t> ResultsFile::flips() const { return gather<uint32_t>(Column::Flips); }
+
+std::vector<TrialRecord::Outcome> ResultsFile::outcomes() const {
+    std::vector<uint8_t> raw = gather<uint8_t>(Column::Outcome);
+    std::vector<TrialRecord::Outcome> values(raw.size());
+    for (size_t i = 0; i < raw.size(); i++) {
+        values[i] = raw[i] < uint8_t(TrialRecord::Outcome::MAX) ? TrialRecord::Outcome(raw[i]) : TrialRecord::Outcome::MAX;
+    }
+    return values;
+}
+
+size_t ResultsFile::locate(size_t i, size_t& row) const {
+    if (i >= trials) {
+        throw std::out_of_range("Trial " + std::to_string(i) + " of " + std::to_string(trials));
+    }
+    size_t b = size_t(std::upper_bound(first.begin(), first.end(), i) - first.begin()) - 1;
+    row = i - first[b];
+    return b;
+}
+
+TrialRecord ResultsFile::at(size_t i) const {
+    size_t row;
+    size_t b = locate(i, row);
+    TrialRecord r;
+    std::memcpy(&r.seed, column(b, Column::Seed) + row * sizeof(uint64_t), sizeof(uint64_t));
+    std::memcpy(&r.metric, column(b, Column::Metric) + row * sizeof(double), sizeof(double));
+    std::memcpy(&r.seconds, column(b, Column::Seconds) + row * sizeof(double), sizeof(double));
+    std::memcpy(&r.map_id, column(b, Column::MapId) + row * sizeof(uint32_t), sizeof(uint32_t));
+    std::memcpy(&r.flips, column(b, Column::Flips) + row * sizeof(uint32_t), sizeof(uint32_t));
+    uint8_t outcome = uint8_t(column(b, Column::Outcome)[row]);
+    r.outcome = outcome < uint8_t(TrialRecord::Outcome::MAX) ? TrialRecord::Outcome(outcome) : TrialRecord::Outcome::MAX;
+    return r;
+}
+
+std::vector<Vflip> ResultsFile::plan(size_t i) const {
+    size_t row;
+    size_t b = locate(i, row);
+    uint32_t range[2];
+    std::memcpy(range, column(b, Column::PlanOffset) + row * sizeof(uint32_t), sizeof(range));
+    if (range[0] > range[1] || range[1] > index[b].plan_entries) {
+        throw std::runtime_error("Corrupt plan offsets at trial " + std::to_string(i));
+    }
+    const char* vaddr = column(b, Column::PlanVaddr);
+    const char* paddr = column(b, Column::PlanPaddr);
+    const char* mask = column(b, Column::PlanMask);
+    std::vector<Vflip> flips(range[1] - range[0]);
+    for (uint32_t e = range[0]; e < range[1]; e++) {
+        uint64_t v, p;
+        std::memcpy(&v, vaddr + e * sizeof(uint64_t), sizeof(v));
+        std::memcpy(&p, paddr + e * sizeof(uint64_t), sizeof(p));
+        flips[e - range[0]] = {uintptr_t(v), uintptr_t(p), uint8_t(mask[e])};
+    }
+    return flips;
+}
+
+TrialRecord::Outcome ResultsFile::classify(TrialRecord::Outcome outcome, double metric, double golden, double tolerance) {
+    if (outcome != TrialRecord::Outcome::Completed) return outcome;
+    return metric >= golden - tolerance ? TrialRecord::Outcome::Masked : TrialRecord::Outcome::SDC;
+}
@@ -0,0 +1,157 @@
+#include "DRAMStandard.h"
+#include "../address_mapper.h"
+
+#include <stdexcept>
+#include <cstring>
+
+using namespace std;
+using namespace famulator;
+
+// Organization tables, counts are {Ch, Ra, Bg, Ba, Ro, Co}; channels and ranks come from the config.
+constexpr DRAMOrg ddr3_orgs[] = {
+    {"512Mb_x4",  512,   4, {0, 0, 0, 8, 1<<13, 1<<11}},
+    {"512Mb_x8",  512,   8, {0, 0, 0, 8, 1<<13, 1<<10}},
+    {"512Mb_x16", 512,  16, {0, 0, 0, 8, 1<<12, 1<<10}},
+    {"1Gb_x4",    1<<10, 4, {0, 0, 0, 8, 1<<14, 1<<11}},
+    {"1Gb_x8",    1<<10, 8, {0, 0, 0, 8, 1<<14, 1<<10}},
+    {"1Gb_x16",   1<<10, 16, {0, 0, 0, 8, 1<<13, 1<<10}},
+    {"2Gb_x4",    2<<10, 4, {0, 0, 0, 8, 1<<15, 1<<11}},
+    {"2Gb_x8",    2<<10, 8, {0, 0, 0, 8, 1<<15, 1<<10}},
+    {"2Gb_x16",   2<<10, 16, {0, 0, 0, 8, 1<<14, 1<<10}},
+    {"4Gb_x4",    4<<10, 4, {0, 0, 0, 8, 1<<16, 1<<11}},
+    {"4Gb_x8",    4<<10, 8, {0, 0, 0, 8, 1<<16, 1<<10}},
+    {"4Gb_x16",   4<<10, 16, {0, 0, 0, 8, 1<<15, 1<<10}},
+    {"8Gb_x4",    8<<10, 4, {0, 0, 0, 8, 1<<16, 1<<12}},
+    {"8Gb_x8",    8<<10, 8, {0, 0, 0, 8, 1<<16, 1<<11}},
+    {"8Gb_x16",   8<<10, 16, {0, 0, 0, 8, 1<<16, 1<<10}},
+};
+
+constexpr DRAMOrg ddr4_orgs[] = {
+    {"2Gb_x4",   2<<10,  4, {0, 0, 4, 4, 1<<15, 1<<10}},
+    {"2Gb_x8",   2<<10,  8, {0, 0, 4, 4, 1<<14, 1<<10}},
+    {"2Gb_x16",  2<<10, 16, {0, 0, 2, 4, 1<<14, 1<<10}},
+    {"4Gb_x4",   4<<10,  4, {0, 0, 4, 4, 1<<16, 1<<10}},
+    {"4Gb_x8",   4<<10,  8, {0, 0, 4, 4, 1<<15, 1<<10}},
+    {"4Gb_x16",  4<<10, 16, {0, 0, 2, 4, 1<<15, 1<<10}},
+    {"8Gb_x4",   8<<10,  4, {0, 0, 4, 4, 1<<17, 1<<10}},
+    {"8Gb_x8",   8<<10,  8, {0, 0, 4, 4, 1<<16, 1<<10}},
+    {"8Gb_x16",  8<<10, 16, {0, 0, 2, 4, 1<<16, 1<<10}},
+    {"16Gb_x4", 16<<10,  4, {0, 0, 4, 4, 1<<18, 1<<10}},
+    {"16Gb_x8", 16<<10,  8, {0, 0, 4, 4, 1<<17, 1<<10}},
+    {"16Gb_x16", 16<<10, 16, {0, 0, 2, 4, 1<<17, 1<<10}},
+};
+
+constexpr DRAMOrg lpddr3_orgs[] = {
+    {"4Gb_x16", 4<<10, 16, {0, 0, 0, 8, 1<<14, 1<<11}},
+    {"4Gb_x32", 4<<10, 32, {0, 0, 0, 8, 1<<14, 1<<10}},
+    {"6Gb_x16", 6<<10, 16, {0, 0, 0, 8, 3<<13, 1<<11}},
+    {"6Gb_x32", 6<<10, 32, {0, 0, 0, 8, 3<<13, 1<<10}},
+    {"8Gb_x16", 8<<10, 16, {0, 0, 0, 8, 1<<15, 1<<11}},
+    {"8Gb_x32", 8<<10, 32, {0, 0, 0, 8, 1<<15, 1<<10}},
+};
+
+constexpr DRAMOrg gddr5_orgs[] = {
+    {"512Mb_x16", 512,   16, {0, 0, 4, 2, 1<<12, 1<<10}},
+    {"512Mb_x32", 512,   32, {0, 0, 4, 2, 1<<12, 1<<9}},
+    {"1Gb_x16",   1<<10, 16, {0, 0, 4, 4, 1<<12, 1<<10}},
+    {"1Gb_x32",   1<<10, 32, {0, 0, 4, 4, 1<<12, 1<<9}},
+    {"2Gb_x16",   2<<10, 16, {0, 0, 4, 4, 1<<13, 1<<10}},
+    {"2Gb_x32",   2<<10, 32, {0, 0, 4, 4, 1<<13, 1<<9}},
+    {"4Gb_x16",   4<<10, 16, {0, 0, 4, 4, 1<<14, 1<<10}},
+    {"4Gb_x32",   4<<10, 32, {0, 0, 4, 4, 1<<14, 1<<9}},
+    {"8Gb_x16",   8<<10, 16, {0, 0, 4, 4, 1<<14, 1<<11}},
+    {"8Gb_x32",   8<<10, 32, {0, 0, 4, 4, 1<<14, 1<<10}},
+};
+
+// per 128-bit channel
+constexpr DRAMOrg hbm_orgs[] = {
+    {"1Gb", 1<<10, 128, {0, 0, 4, 2, 1<<13, 1<<7}},
+    {"2Gb", 2<<10, 128, {0, 0, 4, 2, 1<<14, 1<<7}},
+    {"4Gb", 4<<10, 128, {0, 0, 4, 4, 1<<14, 1<<7}},
+};
+
+// per die (4 channels)
+constexpr DRAMOrg wideio_orgs[] = {
+    {"1Gb", 1<<10, 128, {0, 0, 0, 4, 1<<12, 1<<7}},
+    {"2Gb", 2<<10, 128, {0, 0, 0, 4, 1<<13, 1<<7}},
+    {"4Gb", 4<<10, 128, {0, 0, 0, 4, 1<<14, 1<<7}},
+    {"8Gb", 8<<10, 128, {0, 0, 0, 4, 1<<15, 1<<7}},
+};
+
+// per die (8 channels)
+constexpr DRAMOrg wideio2_orgs[] = {
+    {"4Gb", 4<<10, 64, {0, 0, 0, 8, 1<<12, 1<<8}},
+    {"8Gb", 8<<10, 64, {0, 0, 0, 8, 1<<13, 1<<8}},
+};
+
+#define ORGS(table) table, int(sizeof(table) / sizeof(table[0]))
+
+// ALDRAM, PCM and STTMRAM use DDR3 organizations; SALP/DSARP/TLDRAM need a subarray level
+// and are not registered.
+constexpr DRAMStandardInfo dram_standards[] = {
+    {"DDR3",    DRAMFamily::Flat,     64,  8, ORGS(ddr3_orgs)},
+    {"ALDRAM",  DRAMFamily::Flat,     64,  8, ORGS(ddr3_orgs)},
+    {"PCM",     DRAMFamily::Flat,     64,  8, ORGS(ddr3_orgs)},
+    {"STTMRAM", DRAMFamily::Flat,     64,  8, ORGS(ddr3_orgs)},
+    {"DDR4",    DRAMFamily::Grouped,  64,  8, ORGS(ddr4_orgs)},
+    {"LPDDR3",  DRAMFamily::Flat,     64,  8, ORGS(lpddr3_orgs)},
+    {"LPDDR4",  DRAMFamily::LPDDR4,  128, 16, nullptr, 0},
+    {"GDDR5",   DRAMFamily::Grouped,  64,  8, ORGS(gddr5_orgs)},
+    {"HBM",     DRAMFamily::Grouped, 128,  2, ORGS(hbm_orgs)},
+    {"WideIO",  DRAMFamily::Flat,    128,  4, ORGS(wideio_orgs)},
+    {"WideIO2", DRAMFamily::Flat,     64,  4, ORGS(wideio2_orgs)},
+};
+
+#undef ORGS
+
+const DRAMStandardInfo* famulator::find_dram_standard(const string& name) {
+    for (const auto& standard : dram_standards) {
+        if (name == standard.name)
+            return &standard;
+    }
+    return nullptr;
+}
+
+const DRAMOrg* famulator::find_dram_org(const DRAMStandardInfo& standard, const string& org) {
+    size_t prefix = strlen(standard.name);
+    if (org.compare(0, prefix, standard.name) != 0 || org.size() <= prefix + 1 || org[prefix] != '_')
+        return nullptr;
+    for (int i = 0; i < standard.org_count; i++) {
+        if (org.compare(prefix + 1, string::npos, standard.orgs[i].name) == 0)
+            return &standard.orgs[i];
+    }
+    return nullptr;
+}
+
+template <>
+string TableDRAM<false>::level_str [int(TableDRAM<false>::Level::MAX)] = {"Ch", "Ra", "Ba", "Ro", "Co"};
+template <>
+string TableDRAM<true>::level_str [int(TableDRAM<true>::Level::MAX)] = {"Ch", "Ra", "Bg", "Ba", "Ro", "Co"};
+
+template <bool BankGroups>
+TableDRAM<BankGroups>::TableDRAM(const string& standard, const string& org)
+    : standard_name(standard)
+{
+    const DRAMStandardInfo* info = find_dram_standard(standard);
+    DRAMFamily family = BankGroups ? DRAMFamily::Grouped : DRAMFamily::Flat;
+    if (!info || info->family != family)
+        throw invalid_argument("DRAM standard " + standard + " is not a " + (BankGroups ? "grouped" : "flat") + " table standard.");
+    const DRAMOrg* entry = find_dram_org(*info, org);
+    if (!entry)
+        throw invalid_argument("Unknown organization " + org + " for DRAM standard " + standard + ".");
+
+    org_entry.size = entry->size;
+    org_entry.dq = entry->dq;
+    // the table columns follow AddressMapper::Field, pick the ones this level set has
+    for (int lvl = 0; lvl < int(Level::MAX); lvl++) {
+        for (int f = 0; f < int(AddressMapper::Field::MAX); f++) {
+            if (level_str[lvl] == AddressMapper::field_str[f])
+                org_entry.count[lvl] = entry->count[f];
+        }
+    }
+    prefetch_size = info->prefetch_size;
+    channel_width = info->channel_width;
+}
+
+template class famulator::TableDRAM<false>;
+template class famulator::TableDRAM<true>;
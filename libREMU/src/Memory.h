@@ -2,6 +2,7 @@
 #define __MEMORY_H
 
 #include "Config.h"
+#include "../device_model.h"
 #include <vector>
 #include <functional>
 #include <cmath>
@@ -10,10 +11,11 @@
 #include <random>
 #include <algorithm>
 #include <set>
+#include <array>
+#include <string>
+#include <stdexcept>
+#include <cstdio>
 using namespace std;
-typedef vector<unsigned int> MapSrcVector;
-typedef map<unsigned int, MapSrcVector > MapSchemeEntry;
-typedef map<unsigned int, MapSchemeEntry> MapScheme;
 
 namespace famulator
 {
@@ -23,7 +25,7 @@ public:
     MemoryBase() {}
     virtual ~MemoryBase() {}
     virtual void getAddressInfo(uintptr_t s_paddr, uintptr_t e_paddr) = 0;
-    virtual void offset(vector<uintptr_t>& errors, int ro_ref, int co_ref, int error_bit_num, int seed) = 0;
+    virtual void offset(vector<uintptr_t>& errors, int64_t ro_ref, int64_t co_ref, int error_bit_num, int seed) = 0;
 };
 
 // template <class T, template<typename> class Controller = Controller >
@@ -33,7 +35,6 @@ class Memory : public MemoryBase
 
 protected:
   long max_paddr;
-  MapScheme mapping_scheme;
   
 public:
     // enum class Type {
@@ -43,57 +44,43 @@ public:
     // } type = Type::RoBaRaCoCh;
 
     // vector<Controller<T>*> ctrls;
-    T * spec;
-    vector<int> addr_bits;
+    std::shared_ptr<const DeviceModel<T>> model; // cached spec and mapping, shared between instances
+    const T * spec;
+    const vector<int>& addr_bits;
+    const MapScheme& mapping_scheme;
     // string mapping_file;
     // bool use_mapping_file;
-    bool dump_mapping;
     vector<int> s_vec;
     vector<int> e_vec;
-    vector<int> s_lvl, e_lvl;
+    vector<int64_t> s_lvl, e_lvl; // level indices of the range ends, rows and columns up to 32 bits
     vector<bool> fix_lvl;
     int byte_idx;
+    template <typename V>
+    using LevelArray = std::array<V, int(T::Level::MAX)>;
     // int ofs_bits;
     vector<vector<int>> has_ch_ra_ba_xor;
     vector<vector<int>> has_ch_ra_ba;
     
-    Memory(T* spec, const Config& configs)
-        : spec(spec),
-          addr_bits(int(T::Level::MAX))
+    explicit Memory(std::shared_ptr<const DeviceModel<T>> model)
+        : model(model),
+          spec(model->spec.get()),
+          addr_bits(model->addr_bits),
+          mapping_scheme(model->mapping_scheme),
+          byte_idx(model->byte_idx)
     {
-        // make sure 2^N channels/ranks
-        int *sz = spec->org_entry.count;
-        if (((sz[0] & (sz[0] - 1)) != 0) || ((sz[1] & (sz[1] - 1)) != 0)) {
-            std::cerr << "Make sure 2^N channels/ranks" << std::endl;
-            return;
-        }
-        // the least significant bits of the physical address are not used for addressing (serve as byte index)
-        assert(spec->org_entry.dq * 8 == spec->channel_width);
-        byte_idx = calc_log2(spec->org_entry.dq);
-        assert((1<<byte_idx) ==spec->org_entry.dq);
-        // bit_idx = calc_log2(spec->channel_width);
-
-        // Parsing mapping file and initialize mapping table
-        dump_mapping = true;
-        init_mapping_with_file(configs["mapping"]);
-        
         // If hi address bits will not be assigned to Rows
         // then the chips must not be LPDDRx 6Gb, 12Gb etc.
         // if (type != Type::RoBaRaCoCh && spec->standard_name.substr(0, 5) == "LPDDR")
         //     assert((sz[int(T::Level::Row)] & (sz[int(T::Level::Row)] - 1)) == 0);
-
-        for (unsigned int lev = 0; lev < addr_bits.size(); lev++) {
-            addr_bits[lev] = calc_log2(sz[lev]);
-        }
-    }
-
-    ~Memory()
-    {
-        delete spec;
     }
 
 
     void getAddressInfo(uintptr_t s_paddr, uintptr_t e_paddr) {
+        const int width = address_bits();
+        if (width < int(sizeof(uintptr_t) * 8) && (e_paddr >> width) != 0) {
+            throw std::invalid_argument("Physical range ends at 0x" + to_hex(e_paddr) + ", beyond the " +
+                                        std::to_string(width) + "-bit address width of the mapping");
+        }
         s_vec.resize(addr_bits.size());
         e_vec.resize(addr_bits.size());
         s_lvl.resize(addr_bits.size());
@@ -103,10 +90,11 @@ public:
         s_paddr = clear_lower_bits(s_paddr, byte_idx);
         e_paddr = clear_lower_bits(e_paddr, byte_idx);
         apply_mapping(s_paddr, e_paddr);
+        init_xor_taps();
     }
 
 
-    void offset(vector<uintptr_t>& errors, int ro_ref, int co_ref, int error_bit_num, int seed){
+    void offset(vector<uintptr_t>& errors, int64_t ro_ref, int64_t co_ref, int error_bit_num, int seed){
         // cout <<"[offset]row and column range: "<< dec << s_lvl[int(T::Level::Row)] << " " << e_lvl[int(T::Level::Row)] <<" " << s_lvl[int(T::Level::Column)] << " " << e_lvl[int(T::Level::Column)] << endl;
         vector<ErrorIndex> error_index_map = selectErrorBits(ro_ref, co_ref, error_bit_num, seed);
         // cout<<"[error bit map](row, column) of error bits: "<<endl;
@@ -122,20 +110,20 @@ public:
         int64_t ofs = 0;
         mt19937 gen;
         gen.seed(seed);
-        std::uniform_int_distribution<int64_t> bytes_rand(0, (1<<byte_idx)-1);
+        std::uniform_int_distribution<int64_t> bytes_rand(0, (int64_t(1)<<byte_idx)-1);
         offset_byte = bytes_rand(gen);
         // cout<<"offset_byte: "<<offset_byte<<endl;
         
         int64_t single_bit;
-        vector<int> ref_xor_base(int(T::Level::MAX));
-        vector<int> xor_base(int(T::Level::MAX));
+        LevelArray<int64_t> ref_xor_base = {};
+        LevelArray<int64_t> xor_base = {};
         //channel/bank/rank offset
         for(int lvl = 0; lvl < int(T::Level::MAX)-2 ; lvl++){
             // cout<<spec->level_str[lvl]<<": ";
             if (has_ch_ra_ba_xor[lvl].size() == 0){
                 // bank、channel and rank in has_ch_ra_ba are fixed. There is no need to randomly set 'ref_xor_base'.
                 if(fix_lvl[lvl]){
-                    if(has_ch_ra_ba[lvl].size()!=0) ofs += (s_lvl[lvl]<<has_ch_ra_ba[lvl][0]);
+                    if(has_ch_ra_ba[lvl].size()!=0) ofs += (int64_t(s_lvl[lvl])<<has_ch_ra_ba[lvl][0]);
                     else ofs += s_lvl[lvl];
                     // cout<<"ofs: "<<ofs<<endl;
                     continue;
@@ -165,14 +153,15 @@ public:
                     // cout<<"random single_bit: "<<single_bit<<" ";
                     ref_xor_base[lvl] += (single_bit<<i);
                     // cout<<"ref_xor_base: "<<ref_xor_base[lvl]<<" ";
-                    xor_base[lvl] += (1<<i);
+                    xor_base[lvl] += (int64_t(1)<<i);
                     // cout<<"xor_base: "<<xor_base[lvl]<<endl;
                 }
             }
             // cout<<endl;
         }
-        vector<int>ref_xor_result(int(T::Level::MAX));
-        vector<int>ref_xor_index = calculate_xor(co_ref, ro_ref);
+        LevelArray<int64_t> ref_xor_result = {};
+        LevelArray<int64_t> ref_xor_index;
+        calculate_xor(co_ref, ro_ref, ref_xor_index);
         // cout<<"ref_xor_result: ";
         for(int lvl=0; lvl<int(T::Level::MAX)-2; lvl++){
             ref_xor_result[lvl] = ref_xor_index[lvl] xor ref_xor_base[lvl];
@@ -181,14 +170,15 @@ public:
         // cout<<endl;
         
         //channel/bank/rank offset (for xor, each index has unique xor offset)
+        errors.reserve(errors.size() + error_index_map.size());
+        LevelArray<int64_t> index_xor_index;
+        LevelArray<int64_t> index_xor_result;
         for(const auto& index : error_index_map){
             int64_t xor_offset=0;
             bool flag = true;
             int64_t co_offset_item = index.column;
             int64_t ro_offset_item = index.row;
-            vector<int> index_xor_index;
-            vector<int64_t> index_xor_result(int(T::Level::MAX));
-            index_xor_index = calculate_xor(co_offset_item, ro_offset_item);
+            calculate_xor(co_offset_item, ro_offset_item, index_xor_index);
             for (int lvl = 0; lvl<int(T::Level::MAX)-2; lvl++){
                 // cout<<spec->level_str[lvl]<<": ";
                 index_xor_result[lvl] = index_xor_index[lvl] xor ref_xor_result[lvl];
@@ -211,11 +201,11 @@ public:
             }
             // cout<<"flag: "<<flag<<endl; 
             if (index.row != -1 && index.column != -1) {
-                offset_item = (ro_offset_item << mapping_scheme[int(T::Level::Row)][0][0]) +
-                            (co_offset_item << mapping_scheme[int(T::Level::Column)][0][0]) +
+                offset_item = (ro_offset_item << row_base) +
+                            (co_offset_item << col_base) +
                             ofs + xor_offset;
             } else if (index.column != -1) {
-                offset_item = (e_lvl[int(T::Level::Row)] << mapping_scheme[int(T::Level::Row)][0][0]) + (co_offset_item << mapping_scheme[int(T::Level::Column)][0][0]) + ofs + xor_offset;
+                offset_item = (int64_t(e_lvl[int(T::Level::Row)]) << row_base) + (co_offset_item << col_base) + ofs + xor_offset;
             } else {
                 throw std::invalid_argument("Invalid row index and column index");
             }
@@ -230,111 +220,29 @@ public:
         }
     }
 
-    void init_mapping_with_file(string filename){
-        ifstream file(filename);
-        // possible line types are:
-        // 0. Empty line
-        // 1. Direct bit assignment   : component N   = x
-        // 2. Direct range assignment : component N:M = x:y
-        // 3. XOR bit assignment      : component N   = x y z ...
-        // 4. Comment line            : # comment here
-        string line;
-        char delim[] = " \t";
-        while (getline(file, line)) {
-            short capture_flags = 0;
-            int level = -1;
-            int target_bit = -1, target_bit2 = -1;
-            int source_bit = -1, source_bit2 = -1;
-            // cout << "Processing: " << line << endl;
-            bool is_range = false;
-            while (true) { // process next word
-                size_t start = line.find_first_not_of(delim);
-                if (start == string::npos) // no more words
-                    break;
-                size_t end = line.find_first_of(delim, start);
-                string word = line.substr(start, end - start);
-                
-                if (word.at(0) == '#')// starting a comment
-                    break;
-                if (word == "Burst_length"){
-                    line = line.substr(end);
-                    start = line.find_first_not_of(delim);
-                    if (start == string::npos) // no more words
-                        break;
-                    end = line.find_first_of(delim, start);
-                    word = line.substr(start, end - start);
-                    spec->prefetch_size = stoi(word);
-                    break;
-                }
-                size_t col_index;
-                int source_min, target_min, target_max;
-                switch (capture_flags){
-                    case 0: // capturing the component name
-                        // fetch component level from channel spec
-                        for (int i = 0; i < int(T::Level::MAX); i++)
-                            if (word.find(T::level_str[i]) != string::npos) {
-                                level = i;
-                                capture_flags ++;
-                            }
-                        break;
-
-                    case 1: // capturing target bit(s)
-                        col_index = word.find(":");
-                        if ( col_index != string::npos ){
-                            target_bit2 = stoi(word.substr(col_index+1));
-                            word = word.substr(0,col_index);
-                            is_range = true;
-                        }
-                        target_bit = stoi(word);
-                        capture_flags ++;
-                        break;
-
-                    case 2: //this should be the delimiter
-                        assert(word.find("=") != string::npos);
-                        capture_flags ++;
-                        break;
-
-                    case 3:
-                        if (is_range){
-                            col_index = word.find(":");
-                            source_bit  = stoi(word.substr(0,col_index));
-                            source_bit2 = stoi(word.substr(col_index+1));
-                            assert(source_bit2 - source_bit == target_bit2 - target_bit);
-                            source_min = min(source_bit, source_bit2);
-                            target_min = min(target_bit, target_bit2);
-                            target_max = max(target_bit, target_bit2);
-                            while (target_min <= target_max){
-                                mapping_scheme[level][target_min].push_back(source_min);
-                                // cout << target_min << " <- " << source_min << endl;
-                                source_min ++;
-                                target_min ++;
-                            }
-                        }
-                        else {
-                            source_bit = stoi(word);
-                            mapping_scheme[level][target_bit].push_back(source_bit);
-                        }
-                }
-                if (end == string::npos) { // this is the last word
-                    break;
-                }
-                line = line.substr(end);
+    /**
+     * Device-address bits the mapping can represent: byte_idx plus the highest mapped source bit.
+    */
+    int address_bits() const {
+        int bits = 0;
+        for (const auto& level : mapping_scheme) {
+            for (const auto& entry : level.second) {
+                for (unsigned int src : entry.second) bits = std::max(bits, int(src) + 1);
             }
         }
-        // if (dump_mapping)
-        //     dump_mapping_scheme();
+        return bits + byte_idx;
     }
-    
-    void dump_mapping_scheme(){
+
+    void dump_mapping_scheme() const {
         cout << "Mapping Scheme: " << endl;
-        for (MapScheme::iterator mapit = mapping_scheme.begin(); mapit != mapping_scheme.end(); mapit++)
+        for (MapScheme::const_iterator mapit = mapping_scheme.begin(); mapit != mapping_scheme.end(); mapit++)
         {
             int level = mapit->first;
-            for (MapSchemeEntry::iterator entit = mapit->second.begin(); entit != mapit->second.end(); entit++){
+            for (MapSchemeEntry::const_iterator entit = mapit->second.begin(); entit != mapit->second.end(); entit++){
                 cout << T::level_str[level] << "[" << entit->first << "] := ";
                 cout << "PhysicalAddress[" << *(entit->second.begin()) << "]";
                 // entit->second.erase(entit->second.begin());
-                for (MapSrcVector::iterator it = next(entit->second.begin()); it != entit->second.end(); it ++)
+                for (MapSrcVector::const_iterator it = next(entit->second.begin()); it != entit->second.end(); it ++)
                     cout << " xor PhysicalAddress[" << *it << "]";
                 cout << endl;
             }
@@ -346,29 +254,29 @@ public:
         has_ch_ra_ba.resize(int(T::Level::MAX));
 
         for(int lvl = 0; lvl < int(T::Level::MAX); lvl++){
-            int range_max = mapping_scheme[lvl].size()-1;
-            int idx = mapping_scheme[lvl][0].size()-1;
+            int range_max = mapping_scheme.at(lvl).size()-1;
+            int idx = (range_max != -1) ? int(mapping_scheme.at(lvl).at(0).size())-1 : -1;
             if((range_max!=-1) && (idx!=-1)) {
-                s_lvl[lvl] = get_bit_at_range(s_paddr, mapping_scheme[lvl][0][idx], mapping_scheme[lvl][range_max][idx]);
-                e_lvl[lvl] = get_bit_at_range(e_paddr, mapping_scheme[lvl][0][idx], mapping_scheme[lvl][range_max][idx]);
+                s_lvl[lvl] = get_bit_at_range(s_paddr, mapping_scheme.at(lvl).at(0)[idx], mapping_scheme.at(lvl).at(range_max)[idx]);
+                e_lvl[lvl] = get_bit_at_range(e_paddr, mapping_scheme.at(lvl).at(0)[idx], mapping_scheme.at(lvl).at(range_max)[idx]);
             }else{
                 s_lvl[lvl] = 0;
                 e_lvl[lvl] = 0;
             }
             // cout << spec->level_str[lvl]<< ": "<< s_lvl[lvl] << "-" << e_lvl[lvl] << endl;
         }
-        int co_range_max = mapping_scheme[int(T::Level::Column)].size() - 1;
-        int ro_range_max = mapping_scheme[int(T::Level::Row)].size() - 1; 
+        int co_range_max = mapping_scheme.at(int(T::Level::Column)).size() - 1;
+        int ro_range_max = mapping_scheme.at(int(T::Level::Row)).size() - 1; 
         // xor index for channel and bank
         for (int lvl = 0; lvl < int(T::Level::MAX); lvl++){
             // cout<<spec->level_str[lvl]<<endl;
-            for(MapSchemeEntry::iterator entit = mapping_scheme[lvl].begin(); entit!=mapping_scheme[lvl].end(); entit++){
-                for (MapSrcVector::iterator it = entit->second.begin(); it != entit->second.end(); it ++){
-                    if ((1<<static_cast<int>(*it)) <= e_paddr){
-                        if((((*it) <= mapping_scheme[int(T::Level::Column)][co_range_max][0]) && \
-                            ((*it) >= mapping_scheme[int(T::Level::Column)][0][0])) ||\
-                            (((*it) <= mapping_scheme[int(T::Level::Row)][ro_range_max][0]) && \
-                            ((*it) >= mapping_scheme[int(T::Level::Row)][0][0]))){
+            for(MapSchemeEntry::const_iterator entit = mapping_scheme.at(lvl).begin(); entit!=mapping_scheme.at(lvl).end(); entit++){
+                for (MapSrcVector::const_iterator it = entit->second.begin(); it != entit->second.end(); it ++){
+                    if ((uintptr_t(1)<<(*it)) <= e_paddr){
+                        if((((*it) <= mapping_scheme.at(int(T::Level::Column)).at(co_range_max)[0]) && \
+                            ((*it) >= mapping_scheme.at(int(T::Level::Column)).at(0)[0])) ||\
+                            (((*it) <= mapping_scheme.at(int(T::Level::Row)).at(ro_range_max)[0]) && \
+                            ((*it) >= mapping_scheme.at(int(T::Level::Row)).at(0)[0]))){
                                 e_vec[lvl]+=1;
                                 if(lvl < int(T::Level::Row)){ 
                                     has_ch_ra_ba_xor[lvl].push_back(*it);
@@ -382,11 +290,11 @@ public:
                             }
                         }
                     }
-                    if((1<<static_cast<int>(*it)) <= s_paddr){
-                        if((((*it) <= mapping_scheme[int(T::Level::Column)][co_range_max][0]) && \
-                            ((*it) >= mapping_scheme[int(T::Level::Column)][0][0])) ||\
-                            (((*it) <= mapping_scheme[int(T::Level::Row)][ro_range_max][0]) && \
-                            ((*it) >= mapping_scheme[int(T::Level::Row)][0][0]))){
+                    if((uintptr_t(1)<<(*it)) <= s_paddr){
+                        if((((*it) <= mapping_scheme.at(int(T::Level::Column)).at(co_range_max)[0]) && \
+                            ((*it) >= mapping_scheme.at(int(T::Level::Column)).at(0)[0])) ||\
+                            (((*it) <= mapping_scheme.at(int(T::Level::Row)).at(ro_range_max)[0]) && \
+                            ((*it) >= mapping_scheme.at(int(T::Level::Row)).at(0)[0]))){
                                 s_vec[lvl]+=1;
                         }else{
                                 s_vec[lvl]+=1;
@@ -399,74 +307,139 @@ public:
     }
 
 private:
+    // one row/column bit feeding the xor index of a channel/rank/bank level
+    struct XorTap {
+        bool row;
+        int bit; // bit of the row/column index
+        int pos; // bit of xor_index[lvl]
+    };
+    std::vector<XorTap> xor_taps;           // taps of level lvl are [xor_tap_begin[lvl], xor_tap_begin[lvl+1])
+    std::array<int, int(T::Level::MAX)+1> xor_tap_begin;
+    int row_base; // address bit of row bit 0
+    int col_base; // address bit of column bit 0
+
+    // flatten mapping_scheme/has_ch_ra_ba_xor so that offset() does no map lookups or allocation
+    void init_xor_taps(){
+        int co_range_max = mapping_scheme.at(int(T::Level::Column)).size() - 1;
+        int ro_range_max = mapping_scheme.at(int(T::Level::Row)).size() - 1;
+        row_base = mapping_scheme.at(int(T::Level::Row)).at(0)[0];
+        col_base = mapping_scheme.at(int(T::Level::Column)).at(0)[0];
+        int co_hi = mapping_scheme.at(int(T::Level::Column)).at(co_range_max)[0];
+        int ro_hi = mapping_scheme.at(int(T::Level::Row)).at(ro_range_max)[0];
+        xor_taps.clear();
+        for(int lvl = 0; lvl < int(T::Level::MAX); lvl++){
+            xor_tap_begin[lvl] = xor_taps.size();
+            if (lvl >= int(T::Level::MAX)-2) continue;
+            int count = 0;
+            for (auto elem : has_ch_ra_ba_xor[lvl]){
+                if(elem < co_hi && elem > col_base){
+                    xor_taps.push_back({false, elem - col_base, count});
+                }
+                else if(elem < ro_hi && elem > row_base){
+                    xor_taps.push_back({true, elem - row_base, count});
+                }
+                count ++;
+            }
+        }
+        xor_tap_begin[int(T::Level::MAX)] = xor_taps.size();
+    }
+
     struct ErrorIndex {
-        int row;
-        int column;
+        int64_t row;
+        int64_t column;
         bool operator==(const ErrorIndex& other) const {
             return (row == other.row) && (column == other.column);
         }
     };
 
-    bool contains(const std::vector<ErrorIndex>& vec, const ErrorIndex& index) {
-        return std::find(vec.begin(), vec.end(), index) != vec.end();
-    }
-    bool isedge(int& row, int& column){
-        if(row==-1){
-            // cout << "co: " << column << endl;
-            if(column <= s_lvl[int(T::Level::Column)]) column = s_lvl[int(T::Level::Column)];
-            if(column >= e_lvl[int(T::Level::Column)]) column = e_lvl[int(T::Level::Column)];
-            return (column <= s_lvl[int(T::Level::Column)] || column >= e_lvl[int(T::Level::Column)]);
+    // open-addressing set of (row, column) cells, sized once per cluster
+    class CellSet {
+    public:
+        explicit CellSet(size_t max_cells) {
+            size_t capacity = 16;
+            while (capacity < 2 * max_cells)
+                capacity <<= 1;
+            slots.assign(capacity, Cell{-1, -1}); // (row -1, column -1) is never a cluster cell
         }
-        else{
-            if(row <= s_lvl[int(T::Level::Row)]) row = s_lvl[int(T::Level::Row)];
-            if(row >= e_lvl[int(T::Level::Row)]) row = e_lvl[int(T::Level::Row)];
-            if(column <= s_lvl[int(T::Level::Column)]) column = s_lvl[int(T::Level::Column)];
-            if(column >= e_lvl[int(T::Level::Column)]) column = e_lvl[int(T::Level::Column)];
-            return (row <= s_lvl[int(T::Level::Row)] || row >= e_lvl[int(T::Level::Row)] || column <= s_lvl[int(T::Level::Column)] || column >= e_lvl[int(T::Level::Column)]);
+        // false if the cell is already in the set
+        bool insert(int64_t row, int64_t column) {
+            uint64_t key = (uint64_t(row) * 0x9E3779B97F4A7C15ULL) ^ uint64_t(column);
+            size_t mask = slots.size() - 1;
+            size_t i = ((key * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+            while (slots[i].row != -1 || slots[i].column != -1) {
+                if (slots[i].row == row && slots[i].column == column)
+                    return false;
+                i = (i + 1) & mask;
+            }
+            slots[i] = Cell{row, column};
+            return true;
         }
-    }
+    private:
+        struct Cell {
+            int64_t row;
+            int64_t column;
+        };
+        std::vector<Cell> slots;
+    };
 
-    std::vector<ErrorIndex> selectErrorBits(int ro_ref, int co_ref, int error_bit_num, int seed) {
+    /**
+     * Grow a cluster of error_bit_num cells from (ro_ref, co_ref), or along one row of columns
+     * if ro_ref is -1. Edge rows/columns of the range are excluded. Each step picks a random
+     * unvisited neighbour of the cluster (the frontier), so the walk takes at most
+     * error_bit_num steps and returns a shorter cluster only when the range is exhausted.
+    */
+    std::vector<ErrorIndex> selectErrorBits(int64_t ro_ref, int64_t co_ref, int error_bit_num, int seed) {
         std::vector<ErrorIndex> error_index_map;
+        if (co_ref == -1 || error_bit_num <= 0)
+            return error_index_map;
         std::mt19937 gen;
         gen.seed(seed);
-        std::uniform_int_distribution<int> dist(0, 1);
         std::uniform_real_distribution<double> ran(0, 1);
-        if (ro_ref!=-1 && co_ref!=-1){
-            int i=0;
-            while (i < error_bit_num) {
-                ErrorIndex index;
-                index.row = ro_ref;
-                index.column = co_ref;
-                if((!contains(error_index_map, index)) && (!isedge(ro_ref, co_ref))){
-                    error_index_map.push_back(index);
-                    i++;
-                }
-                double rand_num = ran(gen); //multiple events tend to occur along the wordline
-                if ((rand_num >= 0.2) || ro_ref == e_lvl[int(T::Level::Row)]){
-                    if(ro_ref == e_lvl[int(T::Level::Row)])
-                        ro_ref -= 1;
-                    int dx = dist(gen) == 0 ? -1 : 1;  // left or right
-                    co_ref += dx;
-                }else{
-                    int dy = dist(gen) == 0 ? -1 : 1;  // up or down
-                    ro_ref += dy;
-                }
-            }
-            
-        }else if(ro_ref==-1 && co_ref!=-1){
-            int i=0;
-            while (i < error_bit_num) {
-                ErrorIndex index;
-                index.row = ro_ref;
-                index.column = co_ref;
-                if(!contains(error_index_map, index) && !isedge(ro_ref, co_ref)){
-                    error_index_map.push_back(index);
-                    i++;
-                }
-                int dx = dist(gen) == 0 ? -1 : 1;  // left or right
-                co_ref += dx;
-            }
+
+        const bool use_row = (ro_ref != -1);
+        const int64_t co_lo = s_lvl[int(T::Level::Column)] + 1, co_hi = e_lvl[int(T::Level::Column)] - 1;
+        const int64_t ro_lo = s_lvl[int(T::Level::Row)] + 1, ro_hi = e_lvl[int(T::Level::Row)] - 1;
+        if (co_lo > co_hi || (use_row && ro_lo > ro_hi))
+            return error_index_map;
+        co_ref = std::min(std::max(co_ref, co_lo), co_hi);
+        if (use_row)
+            ro_ref = std::min(std::max(ro_ref, ro_lo), ro_hi);
+
+        // every cell enters the frontier at most once: at most 4 neighbours per cluster cell
+        const size_t max_cells = 4 * static_cast<size_t>(error_bit_num) + 1;
+        CellSet seen(max_cells);
+        std::vector<ErrorIndex> along, across; // unvisited neighbours on the same row / adjacent rows
+        error_index_map.reserve(error_bit_num);
+        along.reserve(max_cells);
+        if (use_row)
+            across.reserve(max_cells);
+
+        auto discover = [&](std::vector<ErrorIndex>& frontier, int64_t row, int64_t column) {
+            if (seen.insert(row, column))
+                frontier.push_back({row, column});
+        };
+        auto visit = [&](int64_t row, int64_t column) {
+            error_index_map.push_back({row, column});
+            if (column > co_lo) discover(along, row, column - 1);
+            if (column < co_hi) discover(along, row, column + 1);
+            if (use_row && row > ro_lo) discover(across, row - 1, column);
+            if (use_row && row < ro_hi) discover(across, row + 1, column);
+        };
+        seen.insert(ro_ref, co_ref);
+        visit(ro_ref, co_ref);
+
+        while (static_cast<int>(error_index_map.size()) < error_bit_num) {
+            if (along.empty() && across.empty())
+                break;
+            //multiple events tend to occur along the wordline
+            bool wordline = across.empty() || (!along.empty() && ran(gen) >= 0.2);
+            std::vector<ErrorIndex>& frontier = wordline ? along : across;
+            std::uniform_int_distribution<size_t> pick(0, frontier.size() - 1);
+            size_t k = pick(gen);
+            ErrorIndex next = frontier[k];
+            frontier[k] = frontier.back();
+            frontier.pop_back();
+            visit(next.row, next.column);
         }
 
         return error_index_map;
@@ -503,7 +476,13 @@ private:
     //     lbits >>= bits;
     //     return lbits;
     // }
-    bool get_bit_at(uintptr_t addr, int bit)
+    static std::string to_hex(uintptr_t value)
+    {
+        char buf[2 * sizeof(uintptr_t) + 1];
+        snprintf(buf, sizeof(buf), "%lx", (unsigned long)value);
+        return buf;
+    }
+    bool get_bit_at(uintptr_t addr, int bit) const
     {
         return (((addr >> bit) & 1) == 1);
     }
@@ -511,14 +490,14 @@ private:
     {
         return addr>>bits;
     }
-    int get_bit_at_range(uintptr_t addr, int low, int high)
+    int64_t get_bit_at_range(uintptr_t addr, int low, int high)
     {
         uintptr_t addr_  = clear_lower_bits(addr, low);
-        return  addr_ & ((1<<(high-low+1))-1);
+        return  addr_ & ((uintptr_t(1)<<(high-low+1))-1);
     }
     void set_range(uintptr_t& addr, int range)
     {
-        addr &= ((1<<(range+1))-1);
+        addr &= ((uintptr_t(1)<<(range+1))-1);
     }
     long lrand(void) {
         if(sizeof(int) < sizeof(long)) {
@@ -539,34 +518,19 @@ private:
 
     int64_t calculate_level_ofs(int64_t& level, int elem){
         int64_t offset;
-        offset = (level << elem) & ((1<<(elem+1))-1);
+        offset = (level << elem) & ((int64_t(1)<<(elem+1))-1);
         level >>= 1;
         return offset;
     }
-    vector<int> calculate_xor(int co, int ro){
-        int co_range_max = mapping_scheme[int(T::Level::Column)].size() - 1;
-        int ro_range_max = mapping_scheme[int(T::Level::Row)].size() - 1; 
-        vector<int>xor_index(int(T::Level::MAX));
+    // xor_index[lvl] bit `pos` is column/row bit `bit` of the index, from init_xor_taps()
+    void calculate_xor(int64_t co, int64_t ro, LevelArray<int64_t>& xor_index) const {
+        xor_index.fill(0);
         for(int lvl = 0; lvl < int(T::Level::MAX)-2 ; lvl++){
-            // cout<<spec->level_str[lvl]<<": ";
-            int count = 0;
-            // cout<<" [xor_index] ";
-            for (auto elem : has_ch_ra_ba_xor[lvl]){
-                if(elem < mapping_scheme[int(T::Level::Column)][co_range_max][0] && elem>mapping_scheme[int(T::Level::Column)][0][0]){
-                    // cout<<"co" << " ";
-                    xor_index[lvl] += get_bit_at(co, elem-mapping_scheme[int(T::Level::Column)][0][0]) << count;
-                    // cout<<xor_index[lvl]<<" ";
-                }
-                else if(elem < mapping_scheme[int(T::Level::Row)][ro_range_max][0] && elem>mapping_scheme[int(T::Level::Row)][0][0]){
-                    // cout<<"ro" << " ";
-                    xor_index[lvl] += get_bit_at(ro, elem-mapping_scheme[int(T::Level::Row)][0][0]) << count;
-                    // cout<<xor_index[lvl]<<" ";
-                }
-                count ++;  
+            for (int t = xor_tap_begin[lvl]; t < xor_tap_begin[lvl+1]; t++){
+                const XorTap& tap = xor_taps[t];
+                xor_index[lvl] += int64_t(get_bit_at(tap.row ? ro : co, tap.bit)) << tap.pos;
             }
-            // cout<<endl;
         }
-        return xor_index;
     }
 };
 
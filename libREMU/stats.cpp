@@ -0,0 +1,57 @@
+#include "stats.h"
+#include <ostream>
+
+std::atomic<uint64_t> Stats::phase_ns[int(Stats::Phase::MAX)];
+std::atomic<uint64_t> Stats::phase_calls[int(Stats::Phase::MAX)];
+std::atomic<uint64_t> Stats::counters[int(Stats::Counter::MAX)];
+
+const char* Stats::phase_str(Phase phase) {
+    static const char* names[] = {"iomem", "pagemap", "tree_build", "add_range", "sample", "translate", "ecc", "apply"};
+    return names[int(phase)];
+}
+
+const char* Stats::counter_str(Counter counter) {
+    static const char* names[] = {"pages", "fragments", "sampled", "retries", "duplicates", "tree_bytes",
+                                  "planned", "applied", "injections"};
+    return names[int(counter)];
+}
+
+Stats::Snapshot Stats::snapshot() {
+    Snapshot s;
+    for (int i = 0; i < int(Phase::MAX); i++) {
+        s.ns[i] = phase_ns[i].load(std::memory_order_relaxed);
+        s.calls[i] = phase_calls[i].load(std::memory_order_relaxed);
+    }
+    for (int i = 0; i < int(Counter::MAX); i++) s.count[i] = counters[i].load(std::memory_order_relaxed);
+    return s;
+}
+
+void Stats::reset() {
+    for (int i = 0; i < int(Phase::MAX); i++) {
+        phase_ns[i].store(0, std::memory_order_relaxed);
+        phase_calls[i].store(0, std::memory_order_relaxed);
+    }
+    for (int i = 0; i < int(Counter::MAX); i++) counters[i].store(0, std::memory_order_relaxed);
+}
+
+Stats::Snapshot Stats::Snapshot::operator-(const Snapshot& before) const {
+    Snapshot s;
+    for (int i = 0; i < int(Phase::MAX); i++) {
+        s.ns[i] = ns[i] - before.ns[i];
+        s.calls[i] = calls[i] - before.calls[i];
+    }
+    for (int i = 0; i < int(Counter::MAX); i++) s.count[i] = count[i] - before.count[i];
+    return s;
+}
+
+void Stats::Snapshot::write_json(std::ostream& out) const {
+    out << "{\"enabled\":" << (Stats::enabled() ? "true" : "false") << ",\"phases\":{";
+    for (int i = 0; i < int(Phase::MAX); i++) {
+        out << (i ? "," : "") << '"' << phase_str(Phase(i)) << "\":{\"ns\":" << ns[i] << ",\"calls\":" << calls[i] << '}';
+    }
+    out << "},\"counters\":{";
+    for (int i = 0; i < int(Counter::MAX); i++) {
+        out << (i ? "," : "") << '"' << counter_str(Counter(i)) << "\":" << count[i];
+    }
+    out << "}}";
+}
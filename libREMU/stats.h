@@ -0,0 +1,105 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+
+// 0 compiles REMU_TIMED and REMU_COUNT out (cmake -DREMU_STATS=OFF)
+#ifndef REMU_STATS
+#define REMU_STATS 1
+#endif
+
+/**
+ * Per-phase timing and counters of the injection pipeline.
+ *
+ * REMU_TIMED(phase) times the rest of the enclosing scope and REMU_COUNT(counter, n) adds to a
+ * counter; both are relaxed atomic adds on process-wide totals, so they are safe from several
+ * threads and cost a clock read per phase rather than per address. snapshot() returns the
+ * totals, and the difference of two snapshots covers the work in between (e.g. one trial).
+ * Built with REMU_STATS=0 the macros expand to nothing and the totals stay zero.
+ */
+class Stats {
+public:
+    enum class Phase {
+        Iomem,      // parse_iomem
+        Pagemap,    // getPmems: pagemap reads and fragment building
+        TreeBuild,  // BitmapTree construction (mapping compilation and node allocation)
+        AddRange,   // BitmapTree::addRange
+        Sample,     // BitmapTree::getError and ErrorBitmap draws
+        Translate,  // getValidVA_in_pa: device addresses back to the ROI
+        Ecc,        // EccModel::filter
+        Apply,      // FlipApplier::apply
+        MAX
+    };
+
+    enum class Counter {
+        Pages,       // virtual pages translated through the pagemap
+        Fragments,   // physically contiguous fragments (Pmems) of the ROIs
+        Sampled,     // error addresses drawn
+        Retries,     // draws that were discarded (no leaf or common row found, cluster clipped by the ROI)
+        Duplicates,  // errors on a byte that already had one (merged flips, redrawn clusters)
+        TreeBytes,   // bytes allocated for BitmapTree nodes
+        Planned,     // flips planned (per byte, before ECC)
+        Applied,     // bytes changed by the applier
+        Injections,  // inject() calls
+        MAX
+    };
+
+    struct Snapshot {
+        uint64_t ns[int(Phase::MAX)];
+        uint64_t calls[int(Phase::MAX)];
+        uint64_t count[int(Counter::MAX)];
+
+        Snapshot operator-(const Snapshot& before) const;
+        // {"enabled":..,"phases":{"iomem":{"ns":..,"calls":..},..},"counters":{"pages":..,..}}
+        void write_json(std::ostream& out) const;
+    };
+
+    static Snapshot snapshot();
+    static void reset();
+    static bool enabled() { return REMU_STATS != 0; }
+
+    static void add(Counter counter, uint64_t n) { counters[int(counter)].fetch_add(n, std::memory_order_relaxed); }
+    static void record(Phase phase, uint64_t ns) {
+        phase_ns[int(phase)].fetch_add(ns, std::memory_order_relaxed);
+        phase_calls[int(phase)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static const char* phase_str(Phase phase);
+    static const char* counter_str(Counter counter);
+
+    class Timer {
+    public:
+        explicit Timer(Phase phase) : phase(phase), start(std::chrono::steady_clock::now()) {}
+        ~Timer() {
+            record(phase, uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                       std::chrono::steady_clock::now() - start).count()));
+        }
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+
+    private:
+        Phase phase;
+        std::chrono::steady_clock::time_point start;
+    };
+
+private:
+    static std::atomic<uint64_t> phase_ns[int(Phase::MAX)];
+    static std::atomic<uint64_t> phase_calls[int(Phase::MAX)];
+    static std::atomic<uint64_t> counters[int(Counter::MAX)];
+};
+
+#define REMU_STATS_CAT2(a, b) a##b
+#define REMU_STATS_CAT(a, b) REMU_STATS_CAT2(a, b)
+
+#if REMU_STATS
+#define REMU_TIMED(phase) Stats::Timer REMU_STATS_CAT(remu_timer_, __LINE__)(Stats::Phase::phase)
+#define REMU_COUNT(counter, n) Stats::add(Stats::Counter::counter, uint64_t(n))
+#else
+#define REMU_TIMED(phase) do {} while (0)
+#define REMU_COUNT(counter, n) do {} while (0)
+#endif
+
+#endif // STATS_H
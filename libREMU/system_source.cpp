@@ -0,0 +1,120 @@
+#include "system_source.h"
+#include <iostream>
+#include <stdexcept>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+ProcSource::~ProcSource() {
+    if (fd >= 0) close(fd);
+}
+
+bool ProcSource::iomem(std::string& text) {
+    int file = open("/proc/iomem", O_RDONLY | O_CLOEXEC);
+    if (file < 0) {
+        std::cerr << "[Error] Cannot open /proc/iomem, please run as root." << std::endl;
+        return false;
+    }
+    text.clear();
+    char buf[8192];
+    ssize_t n;
+    while ((n = read(file, buf, sizeof(buf))) != 0) {
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "[Error] Cannot read /proc/iomem: " << strerror(errno) << std::endl;
+            close(file);
+            return false;
+        }
+        text.append(buf, size_t(n));
+    }
+    close(file);
+    return true;
+}
+
+ssize_t ProcSource::pagemap(pid_t pid, uintptr_t first_page, size_t count, uint64_t* entries) {
+    if (fd < 0 || fd_pid != pid) {
+        if (fd >= 0) close(fd);
+        std::string path = "/proc/" + std::to_string(pid) + "/pagemap";
+        fd = open(path.c_str(), O_RDONLY);
+        if (fd == -1) {
+            int err = errno;
+            std::cerr << "Error opening " << path << ": " << strerror(err) << std::endl;
+            errno = err;
+            return -1;
+        }
+        fd_pid = pid;
+    }
+    return pread(fd, entries, count * sizeof(uint64_t), first_page * sizeof(uint64_t));
+}
+
+SyntheticSource::SyntheticSource(const Layout& layout) : config(layout) {
+    const uint64_t pages = uint64_t(layout.capacity_gb) << 18;
+    if (pages == 0 || layout.segments < 1 || layout.run_pages == 0 || pages % layout.run_pages != 0 ||
+        (pages / layout.run_pages) % layout.segments != 0 || layout.base % 4096 || layout.hole % 4096) {
+        throw std::invalid_argument("Bad synthetic layout");
+    }
+    runs = pages / layout.run_pages;
+    segment_pages = pages / layout.segments;
+    double f = std::min(1.0, std::max(0.0, layout.fragmentation));
+    window = std::min<uint64_t>(runs, std::max<uint64_t>(1, uint64_t(std::llround(std::pow(double(runs), f)))));
+}
+
+bool SyntheticSource::iomem(std::string& text) {
+    text.clear();
+    char line[80];
+    for (int s = 0; s < config.segments; s++) {
+        uintptr_t start = config.base + s * ((segment_pages << 12) + config.hole);
+        std::snprintf(line, sizeof(line), "%08lx-%08lx : System RAM\n", (unsigned long)start,
+                      (unsigned long)(start + (segment_pages << 12) - 1));
+        text += line;
+    }
+    return true;
+}
+
+static uint64_t mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// a keyed permutation of the run's window: a 4-round Feistel network over the next even power of
+// two, cycle-walking until the result falls inside the window
+uint64_t SyntheticSource::permute(uint64_t run) const {
+    if (window == 1) return run;
+    const uint64_t first = run - run % window;
+    const uint64_t size = std::min(window, runs - first);
+    if (size == 1) return run;
+    int half = 1;
+    while ((1ULL << (2 * half)) < size) half++;
+    const uint64_t mask = (1ULL << half) - 1;
+    const uint64_t key = mix(config.seed ^ mix(first));
+    uint64_t x = run - first;
+    do {
+        uint64_t l = x >> half, r = x & mask;
+        for (int round = 0; round < 4; round++) {
+            uint64_t t = l ^ (mix(key + round * 0x9e3779b97f4a7c15ULL + r) & mask);
+            l = r;
+            r = t;
+        }
+        x = (l << half) | r;
+    } while (x >= size);
+    return first + x;
+}
+
+uintptr_t SyntheticSource::translate(uintptr_t page) const {
+    const uint64_t frame = permute((page / config.run_pages) % runs) * config.run_pages + page % config.run_pages;
+    const uint64_t segment = frame / segment_pages;
+    return config.base + segment * ((segment_pages << 12) + config.hole) + ((frame % segment_pages) << 12);
+}
+
+ssize_t SyntheticSource::pagemap(pid_t, uintptr_t first_page, size_t count, uint64_t* entries) {
+    for (size_t i = 0; i < count; i++) {
+        entries[i] = (1ULL << 63) | (translate(first_page + i) >> 12);
+    }
+    return ssize_t(count * sizeof(uint64_t));
+}
@@ -0,0 +1,92 @@
+#ifndef SYSTEM_SOURCE_H
+#define SYSTEM_SOURCE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <sys/types.h>
+
+/**
+ * Where MemUtils gets the physical memory layout and the V->P translation from.
+ *
+ * The layout is the text of /proc/iomem (parsed by MemUtils::parse_iomem) and the translation
+ * is a run of pagemap entries in the kernel's format (bit 63 present, bits 0-54 the PFN).
+ * ProcSource reads the real files and needs root; SyntheticSource generates both from a
+ * configurable layout, so scale tests and benchmarks run without root and reproduce any
+ * fragmentation on demand.
+ */
+class SystemSource {
+public:
+    virtual ~SystemSource() {}
+
+    // the /proc/iomem text, false (with a message) when it cannot be read
+    virtual bool iomem(std::string& text) = 0;
+
+    /**
+     * Pagemap entries of `count` virtual pages of `pid` starting at page `first_page`. Returns
+     * the bytes read, as pread on the pagemap file would, or -1 with errno set.
+    */
+    virtual ssize_t pagemap(pid_t pid, uintptr_t first_page, size_t count, uint64_t* entries) = 0;
+};
+
+// /proc/iomem and /proc/<pid>/pagemap of this machine
+class ProcSource : public SystemSource {
+public:
+    ProcSource() : fd(-1), fd_pid(0) {}
+    ~ProcSource();
+    ProcSource(const ProcSource&) = delete;
+    ProcSource& operator=(const ProcSource&) = delete;
+
+    bool iomem(std::string& text) override;
+    // the pagemap file of the last pid stays open
+    ssize_t pagemap(pid_t pid, uintptr_t first_page, size_t count, uint64_t* entries) override;
+
+private:
+    int fd;
+    pid_t fd_pid;
+};
+
+/**
+ * A generated machine: `segments` equal DRAM segments of `capacity_gb` in total, separated by
+ * holes, and a deterministic V->P translation. Virtual pages are grouped into runs of
+ * `run_pages` physically contiguous pages (512 for 2 MiB huge pages). The runs are permuted
+ * within windows of R^fragmentation runs, R being the runs of the whole DRAM: 0 maps virtual
+ * runs to consecutive frames, 1 scatters them over the whole DRAM. The translation is a
+ * bijection of the DRAM (virtual runs wrap around every capacity) and ignores the pid.
+ */
+class SyntheticSource : public SystemSource {
+public:
+    struct Layout {
+        size_t capacity_gb;
+        int segments;          // DRAM segments, in physical address order
+        uintptr_t base;        // physical address of the first segment
+        size_t hole;           // bytes between segments
+        size_t run_pages;      // physically contiguous pages per run (1: 4 KiB pages, 512: 2 MiB)
+        double fragmentation;  // 0: contiguous, 1: every run anywhere in the DRAM
+        uint64_t seed;
+        Layout() : capacity_gb(64), segments(4), base(0x80000000), hole(256ULL << 20), run_pages(1),
+                   fragmentation(0), seed(0) {}
+    };
+
+    // throws std::invalid_argument for an empty or unaligned layout
+    explicit SyntheticSource(const Layout& layout = Layout());
+
+    bool iomem(std::string& text) override;
+    ssize_t pagemap(pid_t pid, uintptr_t first_page, size_t count, uint64_t* entries) override;
+
+    // the physical address of a virtual page
+    uintptr_t translate(uintptr_t page) const;
+
+    const Layout& layout() const { return config; }
+
+private:
+    Layout config;
+    uint64_t runs;          // runs in the whole DRAM
+    uint64_t window;        // runs permuted together
+    uint64_t segment_pages;
+
+    uint64_t permute(uint64_t run) const;
+};
+
+#endif // SYSTEM_SOURCE_H
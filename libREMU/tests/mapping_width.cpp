@@ -0,0 +1,87 @@
+// High-bit sweep of the shipped mappings: ErrorBitmap over a 64 MiB range at every power-of-two
+// base. Inside the address width of the mapping the generated errors must land in the range;
+// a range past the width must be rejected instead of producing errors elsewhere.
+// Run from libREMU/ (ctest sets the working directory).
+#include "../error_bitmap.h"
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+struct Case {
+    const char* cfg;
+    const char* mapping;
+    int width;      // device-address bits (byte_idx + mapped bits)
+    bool in_range;  // every error lands in the range; false when bank/channel bits sit above the row
+                    // bits, which offset() draws at random (mem_utils redraws the misses)
+};
+
+const Case cases[] = {
+    {"configs/DDR4-config.cfg", "mappings/cacheline_interleaving.map", 44, true},
+    {"configs/DDR4-config.cfg", "mappings/cacheline_interleaving_randomized.map", 44, true},
+    {"configs/DDR4-config.cfg", "mappings/row_interleaving.map", 44, true},
+    {"configs/DDR4-config.cfg", "mappings/row_interleaving_randomized.map", 44, true},
+    {"configs/LPDDR4-config.cfg", "mappings/LPDDR4_RoRaBaChCo.map", 33, true},
+    {"configs/LPDDR4-config.cfg", "mappings/LPDDR4_RoRaBaCoCh.map", 33, true},
+    {"configs/LPDDR4-config.cfg", "mappings/LPDDR4_channel_XOR_16.map", 33, true},
+    {"configs/LPDDR4-config.cfg", "mappings/LPDDR4_channel_XOR_32.map", 33, true},
+    {"configs/LPDDR4-config.cfg", "mappings/LPDDR4_row_interleaving_16.map", 33, true},
+    {"configs/LPDDR4-config.cfg", "mappings/LPDDR4_row_interleaving_32.map", 33, true},
+    {"configs/LPDDR4-config.cfg", "mappings/LPDDR4_dumb.map", 33, false},
+};
+
+const uintptr_t range = 64ULL << 20;
+const int seeds = 300;
+const int cluster = 4;
+
+// errors in [start, start + range) over all seeds, -1 if the range was rejected
+long sweep(const Case& c, uintptr_t start, long& total) {
+    std::unique_ptr<ErrorBitmapBase> bitmap = ErrorBitmapBase::create(c.cfg, start, start + range - 1, 4096);
+    try {
+        bitmap->REMU(c.cfg, c.mapping);
+    } catch (const std::invalid_argument&) {
+        return -1;
+    }
+    long in = 0;
+    total = 0;
+    for (int seed = 0; seed < seeds; seed++) {
+        for (uintptr_t error : bitmap->calculateError(cluster, seed)) {
+            total++;
+            in += error >= start && error < start + range;
+        }
+    }
+    return in;
+}
+
+}
+
+int main() {
+    int failures = 0;
+    for (const Case& c : cases) {
+        std::vector<uintptr_t> bases;
+        for (int bit = 26; bit <= 47; bit++) bases.push_back(uintptr_t(1) << bit);
+        bases.push_back((uintptr_t(1) << c.width) - range); // the last range inside the width
+        for (uintptr_t base : bases) {
+            const bool fits = ((base + range - 1) >> c.width) == 0;
+            long total = 0;
+            long in = sweep(c, base, total);
+            const char* error = nullptr;
+            if (!fits && in >= 0) error = "range past the address width was accepted";
+            else if (fits && in < 0) error = "range inside the address width was rejected";
+            else if (fits && total == 0) error = "no errors generated";
+            else if (fits && c.in_range && in != total) error = "errors outside the range";
+            else if (fits && in == 0) error = "no error inside the range";
+            if (error != nullptr) {
+                std::cerr << "[Error] " << c.mapping << " at 0x" << std::hex << base << std::dec << ": " << error
+                          << " (" << in << "/" << total << ")" << std::endl;
+                failures++;
+            }
+        }
+        std::cout << c.mapping << ": " << c.width << "-bit" << std::endl;
+    }
+    if (failures) {
+        std::cerr << failures << " failures" << std::endl;
+        return 1;
+    }
+    return 0;
+}
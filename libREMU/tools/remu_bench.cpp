@@ -0,0 +1,313 @@
+// remu_bench: micro-benchmarks of the injection pipeline over synthetic ROIs.
+//
+//   remu_bench [-s <sizes>] [-r <reps>] [-t <tree mapping>] [-a <max allocation>] [-b <bench>]
+//              [-f <fragmentation>] [-p <run pages>]
+//
+// The tree mapping defaults to configs/lpddr5_jetson_agx_orin.yaml of the source tree.
+// translate/encode and translate/decode time AddressMapper::encode_batch/decode_batch of the tree
+// mapping over 10^7 addresses with each kernel (parity, nibble, bmi2 where available).
+// The ROI lives in a synthetic 64 GB machine (SyntheticSource, 4 DRAM segments) whose physical
+// runs of <run pages> 4 KiB pages (default 16) are permuted with <fragmentation> (default 1, the
+// worst case), so no root is needed. For every ROI size (default 1M,64M,1G,64G) it times
+// BitmapTree::addRange over one contiguous range and over the ROI's pages, getError for SEU and
+// MCU multiplicities, getPmems, P2D/D2P and getValidVA_in_pa. For the sizes up to the
+// allocation limit (default 1G) it also times getPmems on a populated buffer through
+// /proc/self/pagemap and on a DramArena, and flip application with the Direct and ProcMem
+// appliers. -b keeps the benchmarks whose name starts with <bench>. Each result is one JSON line:
+//
+//   {"bench":"addRange/contiguous","roi_bytes":1048576,"ops":256,"ns_per_op":...,
+//    "ops_per_s":...,"bytes_per_s":...,"peak_rss_kb":...}
+//
+// The time is the best of <reps> runs (default 3), ops is what one run does (4 KiB pages for
+// addRange and getPmems, errors for getError, addresses for the translations, flips for the
+// appliers), and peak_rss_kb is the process high-water mark of that benchmark.
+#include "../mem_utils.h"
+#include "../bitmap_tree.h"
+#include "../dram_arena.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <getopt.h>
+#include <sys/mman.h>
+
+// libREMU/ of the build, set by CMake; the default mapping is configs/lpddr5_jetson_agx_orin.yaml there
+#ifndef REMU_SOURCE_DIR
+#define REMU_SOURCE_DIR ".."
+#endif
+
+static void usage() {
+    std::cerr << "./remu_bench [-s <sizes, e.g. 1M,64M,1G,64G>] [-r <reps>] [-t <tree mapping>] "
+                 "[-a <max allocation>] [-b <bench>] [-f <fragmentation>] [-p <run pages>]" << std::endl;
+}
+
+// "64M", "1G", ... in bytes
+static size_t parse_size(const std::string& text) {
+    size_t pos = 0;
+    size_t value = std::stoull(text, &pos);
+    if (pos + 1 == text.size()) {
+        switch (text[pos]) {
+            case 'K': case 'k': return value << 10;
+            case 'M': case 'm': return value << 20;
+            case 'G': case 'g': return value << 30;
+            case 'T': case 't': return value << 40;
+        }
+    }
+    if (pos != text.size()) throw std::invalid_argument("Bad size " + text);
+    return value;
+}
+
+// the peak RSS is reset before each benchmark so that it reports its own high-water mark
+static void reset_peak_rss() {
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    clear_refs << "5" << std::endl;
+}
+
+static long peak_rss_kb() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) return std::stol(line.substr(6));
+    }
+    return -1;
+}
+
+// The private translation steps of MemUtils, timed directly.
+class RemuBench {
+public:
+    RemuBench(int reps, const std::string& filter) : reps(reps), filter(filter) {}
+
+    bool selected(const std::string& name) const { return name.compare(0, filter.size(), filter) == 0; }
+
+    // times `body` (which does `ops` operations over `roi` bytes) and prints the result line
+    void run(const std::string& name, size_t roi, size_t ops, const std::function<void()>& setup,
+             const std::function<void()>& body) {
+        if (!selected(name) || ops == 0) return;
+        reset_peak_rss();
+        double best = 0;
+        for (int r = 0; r < reps; r++) {
+            if (setup) setup();
+            auto start = std::chrono::steady_clock::now();
+            body();
+            double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            if (r == 0 || ns < best) best = ns;
+        }
+        if (best <= 0) best = 1;
+        std::cout << "{\"bench\":\"" << name << "\",\"roi_bytes\":" << roi << ",\"ops\":" << ops
+                  << ",\"ns_per_op\":" << best / ops << ",\"ops_per_s\":" << ops * 1e9 / best
+                  << ",\"bytes_per_s\":" << roi * 1e9 / best << ",\"peak_rss_kb\":" << peak_rss_kb()
+                  << "}" << std::endl;
+    }
+
+    static std::vector<Pmem> getPmems(MemUtils* self, uintptr_t Vaddr, size_t size) {
+        return MemUtils::getPmems(self, Vaddr, size, 4096);
+    }
+    static std::vector<Vmem> getValidVA_in_pa(MemUtils* self, const std::vector<uintptr_t>& daddrs, const std::vector<Pmem>& pmems) {
+        return MemUtils::getValidVA_in_pa(self, daddrs, pmems);
+    }
+
+private:
+    int reps;
+    std::string filter;
+};
+
+int main(int argc, char* argv[]) {
+    std::string sizes = "1M,64M,1G,64G";
+    std::string mapping = REMU_SOURCE_DIR "/configs/lpddr5_jetson_agx_orin.yaml";
+    std::string filter;
+    size_t max_alloc = 1ULL << 30;
+    int reps = 3;
+    SyntheticSource::Layout layout;
+    layout.fragmentation = 1;
+    layout.run_pages = 16;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:r:t:a:b:f:p:")) != -1) {
+        switch (opt) {
+            case 's': sizes = optarg; break;
+            case 'r': reps = std::stoi(optarg); break;
+            case 't': mapping = optarg; break;
+            case 'a': max_alloc = parse_size(optarg); break;
+            case 'b': filter = optarg; break;
+            case 'f': layout.fragmentation = std::stod(optarg); break;
+            case 'p': layout.run_pages = std::stoul(optarg); break;
+            default: usage(); return 1;
+        }
+    }
+    if (optind != argc || reps < 1) {
+        usage();
+        return 1;
+    }
+
+    try {
+        std::vector<size_t> rois;
+        std::stringstream list(sizes);
+        for (std::string size; std::getline(list, size, ',');) rois.push_back(parse_size(size));
+
+        RemuBench bench(reps, filter);
+
+        // AddressMapper::encode_batch/decode_batch over 10^7 line addresses with every kernel that
+        // can express the mapping, one op per address
+        if (bench.selected("translate")) {
+            AddressMapper mapper = AddressMapper::load(mapping, 4);
+            uint64_t used = 0; // line-address bits the mapping reads
+            for (uint64_t row : mapper.forward_rows()) used |= row;
+            const size_t addrs = 10000000;
+            std::vector<uint64_t> lines(addrs), packed(addrs), decoded(addrs), reference(addrs);
+            std::mt19937_64 gen(7);
+            for (uint64_t& line : lines) line = gen() & used;
+            // every kernel must produce the coordinates of the parity kernel
+            mapper.set_kernel(AddressMapper::Kernel::Parity);
+            mapper.encode_batch(lines.data(), reference.data(), addrs);
+            for (AddressMapper::Kernel kernel : {AddressMapper::Kernel::Parity, AddressMapper::Kernel::Nibble,
+                                                 AddressMapper::Kernel::Bmi2, AddressMapper::Kernel::Neon}) {
+                if (!mapper.set_kernel(kernel)) {
+                    std::cerr << "[Warn] the " << AddressMapper::kernel_str(kernel)
+                              << " kernel cannot translate this mapping here, skipping it." << std::endl;
+                    continue;
+                }
+                const std::string suffix = std::string("/") + AddressMapper::kernel_str(kernel);
+                bench.run("translate/encode" + suffix, 0, addrs, nullptr,
+                          [&]() { mapper.encode_batch(lines.data(), packed.data(), addrs); });
+                mapper.encode_batch(lines.data(), packed.data(), addrs);
+                if (packed != reference) throw std::runtime_error(std::string("the ") + AddressMapper::kernel_str(kernel) +
+                                                                  " kernel does not match the parity kernel");
+                bench.run("translate/decode" + suffix, 0, addrs, nullptr,
+                          [&]() { mapper.decode_batch(packed.data(), decoded.data(), addrs); });
+                mapper.decode_batch(packed.data(), decoded.data(), addrs);
+                if (decoded != lines) throw std::runtime_error(std::string("the ") + AddressMapper::kernel_str(kernel) +
+                                                               " kernel does not round-trip the mapping");
+            }
+        }
+
+        SyntheticSource synthetic(layout);
+        MemUtils memUtils(layout.capacity_gb, &synthetic);
+        const std::vector<Pseg> segments = memUtils.pdmapper;
+        std::mt19937_64 rng(42);
+        const size_t page = 4096;
+        const int error_cnt = 1000;
+        const uintptr_t roi_vaddr = 0x7f0000000000;
+
+        for (size_t roi : rois) {
+            roi = std::max(roi & ~(page - 1), page);
+            const size_t pages = roi / page;
+            memUtils.source = &synthetic;
+            memUtils.pdmapper = segments;
+
+            // addRange, one op per 4 KiB page
+            std::unique_ptr<BitmapTree> tree;
+            bench.run("addRange/contiguous", roi, pages,
+                      [&]() { tree.reset(); tree.reset(new BitmapTree(mapping)); },
+                      [&]() { tree->addRange(0, roi - 1); });
+            if (bench.selected("addRange/fragmented")) {
+                // the device addresses of the ROI's pages in the synthetic layout
+                std::vector<uintptr_t> frames(pages);
+                size_t base;
+                for (size_t i = 0; i < pages; i++) frames[i] = memUtils.P2D(synthetic.translate(roi_vaddr / page + i), base);
+                std::unique_ptr<BitmapTree> scattered;
+                bench.run("addRange/fragmented", roi, frames.size(),
+                          [&]() { scattered.reset(); scattered.reset(new BitmapTree(mapping)); },
+                          [&]() { for (uintptr_t f : frames) scattered->addRange(f, f + page - 1); });
+            }
+
+            // getError, one op per error event
+            if (bench.selected("getError")) {
+                if (!tree) {
+                    tree.reset(new BitmapTree(mapping));
+                    tree->addRange(0, roi - 1);
+                }
+                for (int num : {1, 2, 4, 8}) {
+                    std::string name = num == 1 ? "getError/seu" : "getError/mcu" + std::to_string(num);
+                    bench.run(name, roi, error_cnt, nullptr, [&]() { tree->getError(num, error_cnt, 0.8, 0.2, 0); });
+                }
+            }
+            tree.reset();
+
+            // pagemap translation of the ROI in the synthetic layout, one op per 4 KiB page
+            std::vector<Pmem> pmems;
+            bench.run("getPmems/synthetic", roi, pages, nullptr,
+                      [&]() { pmems = RemuBench::getPmems(&memUtils, roi_vaddr, roi); });
+
+            // P2D/D2P over the layout's segments and getValidVA_in_pa over the ROI, one op per address
+            const size_t addrs = 1 << 20;
+            std::vector<uintptr_t> pas(addrs), das(addrs);
+            for (size_t i = 0; i < addrs; i++) {
+                const Pseg& seg = segments[rng() % segments.size()];
+                pas[i] = seg.pa_start + rng() % (seg.pa_end - seg.pa_start + 1);
+                das[i] = pas[i] - seg.da_base;
+            }
+            uintptr_t sink = 0;
+            bench.run("P2D", roi, addrs, nullptr, [&]() {
+                size_t base;
+                for (uintptr_t pa : pas) sink += memUtils.P2D(pa, base);
+            });
+            bench.run("D2P", roi, addrs, nullptr, [&]() {
+                for (uintptr_t da : das) sink += memUtils.D2P(da);
+            });
+            if (bench.selected("getValidVA_in_pa")) {
+                if (pmems.empty()) pmems = RemuBench::getPmems(&memUtils, roi_vaddr, roi);
+                // device addresses inside the ROI
+                std::vector<uintptr_t> daddrs(error_cnt);
+                for (uintptr_t& da : daddrs) {
+                    const Pmem& p = pmems[rng() % pmems.size()];
+                    da = p.s_Daddr + rng() % p.size;
+                }
+                bench.run("getValidVA_in_pa", roi, daddrs.size(), nullptr,
+                          [&]() { sink += RemuBench::getValidVA_in_pa(&memUtils, daddrs, pmems).size(); });
+            }
+            pmems = std::vector<Pmem>();
+            if (sink == 1) std::cerr << std::endl; // keeps the translations from being optimized out
+
+            // the real pagemap and flip application need the ROI in memory
+            if (roi > max_alloc) {
+                if (bench.selected("getPmems/proc") || bench.selected("apply")) {
+                    std::cerr << "[Warn] " << MemUtils::human_readable(roi) << " is above the allocation limit ("
+                              << MemUtils::human_readable(max_alloc) << "), skipping getPmems/proc and apply." << std::endl;
+                }
+                continue;
+            }
+            void* buf = mmap(nullptr, roi, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+            if (buf == MAP_FAILED) throw std::runtime_error("mmap of the ROI failed");
+            uintptr_t base = reinterpret_cast<uintptr_t>(buf);
+
+            // this machine's pagemap, every physical address mapping to itself
+            ProcSource proc;
+            memUtils.source = &proc;
+            memUtils.pdmapper.assign(1, Pseg{0, ~uintptr_t(0) >> 1, 0});
+            bench.run("getPmems/proc", roi, pages, nullptr,
+                      [&]() { sink += RemuBench::getPmems(&memUtils, base, roi).size(); });
+
+            // the ROI in a DRAM arena with the synthetic layout
+            if (bench.selected("getPmems/arena")) {
+                DramArena arena(roi, layout);
+                memUtils.source = &arena;
+                memUtils.pdmapper = segments;
+                uintptr_t weights = reinterpret_cast<uintptr_t>(arena.allocate(roi));
+                bench.run("getPmems/arena", roi, pages, nullptr,
+                          [&]() { sink += RemuBench::getPmems(&memUtils, weights, roi).size(); });
+            }
+            memUtils.source = &synthetic;
+
+            std::vector<Vflip> flips(std::min<size_t>(100000, roi / 8));
+            for (Vflip& f : flips) f = Vflip{base + rng() % roi, 0, uint8_t(1u << (rng() % 8))};
+            std::sort(flips.begin(), flips.end(), [](const Vflip& a, const Vflip& b) { return a.vaddr < b.vaddr; });
+            // every run applies the flips twice, which leaves the buffer unchanged
+            for (FlipApplier::Mode mode : {FlipApplier::Mode::Direct, FlipApplier::Mode::ProcMem}) {
+                FlipApplier applier(mode);
+                bench.run(mode == FlipApplier::Mode::Direct ? "apply/direct" : "apply/procmem", roi, 2 * flips.size(),
+                          nullptr, [&]() { applier.apply(flips); applier.apply(flips); });
+            }
+            munmap(buf, roi);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "[Error] " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
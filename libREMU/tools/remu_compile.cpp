@@ -0,0 +1,76 @@
+// remu_compile: validate a device description and compile it into one binary profile.
+//
+//   remu_compile [-c <ramulator .cfg>] -m <.map | .yaml mapping> -o <profile.remu> [-b <map byte bits>]
+//
+// The profile holds the organization of the configured part, the compiled forward and inverse
+// mapping matrices and the mapping terms. It can be passed wherever libREMU takes a cfg
+// (ErrorBitmap, MemUtils::get_error_Va) or a mapping (BitmapTree); it is loaded with one mmap.
+// Without -c the profile only carries the mapping; -b sets the byte-index bits of a .map file then.
+#include "../device_profile.h"
+#include <iostream>
+#include <string>
+#include <stdexcept>
+#include <cstdlib>
+#include <cerrno>
+#include <getopt.h>
+
+// the whole of `text` as a number in [0, max]
+static bool parse_number(const char* text, int& value, long max) {
+    char* end;
+    errno = 0;
+    long v = std::strtol(text, &end, 10);
+    value = int(v);
+    return end != text && *end == '\0' && errno == 0 && v >= 0 && v <= max;
+}
+
+static void usage() {
+    std::cerr << "./remu_compile [-c <config.cfg>] -m <mapping.map|mapping.yaml> -o <profile.remu> [-b <map byte bits>]" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    std::string cfg, mapping, out;
+    int map_byte_bits = 4;
+    int opt;
+    while ((opt = getopt(argc, argv, "c:m:o:b:")) != -1) {
+        bool ok = true;
+        switch (opt) {
+            case 'c': cfg = optarg; break;
+            case 'm': mapping = optarg; break;
+            case 'o': out = optarg; break;
+            // byte-index bits below a 64-bit device address
+            case 'b': ok = parse_number(optarg, map_byte_bits, 63); break;
+            default: usage(); return 1;
+        }
+        if (!ok) {
+            std::cerr << "[Error] Bad value for -" << char(opt) << ": " << optarg << std::endl;
+            usage();
+            return 1;
+        }
+    }
+    if (mapping.empty() || out.empty()) {
+        usage();
+        return 1;
+    }
+    if (!DeviceProfile::is_profile(out)) {
+        std::cerr << "[Warning] " << out << " does not end in .remu, libREMU will not recognize it as a profile." << std::endl;
+    }
+
+    try {
+        DeviceProfile::compile(cfg, mapping, out, map_byte_bits);
+        DeviceProfile profile(out);
+        const ProfileHeader& h = profile.header();
+        std::cout << out << ": version " << h.version << ", " << h.file_size << " bytes";
+        if (profile.has_device()) {
+            std::cout << ", " << profile.standard() << " " << profile.org() << " x" << h.channels << "ch x" << h.ranks << "ra";
+        }
+        std::cout << ", " << h.coord_bits << " coordinate bits (";
+        for (int f = 0; f < int(AddressMapper::Field::MAX); f++) {
+            std::cout << (f ? " " : "") << AddressMapper::field_str[f] << ":" << h.width[f];
+        }
+        std::cout << "), " << (1 << h.byte_bits) << "-byte index" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "[Error] " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,130 @@
+// remu_errors: generate error maps (multiplicity histograms) with ErrorModel, replacing get_error.py.
+//
+//   remu_errors (-t <total bits> | -f <flux> -s <cross-section> -e <seconds>) [-n <maps>] [-r <seed>] [-o <file>]
+//   remu_errors -i <error_counts.txt> -o <file.emap>
+//
+// With -t every map flips exactly <total bits> bits; with -f/-s/-e the flipped bits of each map are
+// Poisson distributed around flux (particles/cm^2/s) x cross-section (cm^2) x exposure (s).
+// The output has one map per line ("multiplicity:count ..."), the format of error_counts_<N>.txt;
+// it defaults to error_counts_<total bits>.txt with -t and to stdout otherwise. An output ending in
+// .emap is written in the indexed binary format (ErrorMapFile); -i converts an existing text file.
+#include "../error_model.h"
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <stdexcept>
+#include <cstdlib>
+#include <cerrno>
+#include <climits>
+#include <getopt.h>
+
+static void usage() {
+    std::cerr << "./remu_errors (-t <total bits> | -f <flux> -s <cross-section> -e <seconds>) "
+                 "[-n <maps>] [-r <seed>] [-o <file>]" << std::endl;
+    std::cerr << "./remu_errors -i <error_counts.txt> -o <file.emap>" << std::endl;
+}
+
+// whole-string option values; false for text, trailing characters or an out-of-range number
+static bool parse_number(const char* text, double& value) {
+    char* end;
+    errno = 0;
+    value = std::strtod(text, &end);
+    return end != text && *end == '\0' && errno == 0;
+}
+
+static bool parse_number(const char* text, uint64_t& value) {
+    char* end;
+    errno = 0;
+    unsigned long long v = std::strtoull(text, &end, 10);
+    value = v;
+    return end != text && *end == '\0' && errno == 0 && text[0] != '-';
+}
+
+static bool parse_number(const char* text, int& value) {
+    uint64_t v;
+    if (!parse_number(text, v) || v > uint64_t(INT_MAX)) return false;
+    value = int(v);
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    int total_bits = -1;
+    double flux = -1, cross_section = -1, seconds = -1;
+    size_t maps = 1000;
+    uint64_t seed = std::random_device()();
+    std::string in, out;
+    uint64_t map_count = maps;
+    int opt;
+    while ((opt = getopt(argc, argv, "t:f:s:e:n:r:o:i:")) != -1) {
+        bool ok = true;
+        switch (opt) {
+            case 't': ok = parse_number(optarg, total_bits); break;
+            case 'f': ok = parse_number(optarg, flux); break;
+            case 's': ok = parse_number(optarg, cross_section); break;
+            case 'e': ok = parse_number(optarg, seconds); break;
+            case 'n': ok = parse_number(optarg, map_count) && map_count <= SIZE_MAX; maps = size_t(map_count); break;
+            case 'r': ok = parse_number(optarg, seed); break;
+            case 'o': out = optarg; break;
+            case 'i': in = optarg; break;
+            default: usage(); return 1;
+        }
+        if (!ok) {
+            std::cerr << "[Error] Bad value for -" << char(opt) << ": " << optarg << std::endl;
+            usage();
+            return 1;
+        }
+    }
+    if (!in.empty()) {
+        if (out.empty() || total_bits >= 0 || flux >= 0 || cross_section >= 0 || seconds >= 0) {
+            usage();
+            return 1;
+        }
+        if (!ErrorMapFile::is_error_map_file(out)) {
+            std::cerr << "[Warning] " << out << " does not end in .emap, libREMU will read it as text." << std::endl;
+        }
+        std::ifstream text(in);
+        if (!text.is_open()) {
+            std::cerr << "[Error] Cannot open " << in << std::endl;
+            return 1;
+        }
+        ErrorMapBatch batch;
+        batch.read_text(text);
+        try {
+            ErrorMapFile::write(batch, out);
+        } catch (const std::exception& e) {
+            std::cerr << "[Error] " << e.what() << std::endl;
+            return 1;
+        }
+        std::cerr << batch.size() << " error maps converted to " << out << std::endl;
+        return 0;
+    }
+    const bool by_flux = flux >= 0 || cross_section >= 0 || seconds >= 0;
+    if ((total_bits >= 0) == by_flux || (by_flux && (flux < 0 || cross_section < 0 || seconds < 0))) {
+        usage();
+        return 1;
+    }
+
+    try {
+        ErrorModel model = by_flux ? ErrorModel::flux(flux, cross_section, seconds) : ErrorModel::fixed(total_bits);
+        ErrorMapBatch batch = model.sample(maps, seed);
+        if (out.empty() && !by_flux) out = "error_counts_" + std::to_string(total_bits) + ".txt";
+        if (out.empty()) {
+            batch.write_text(std::cout);
+        } else if (ErrorMapFile::is_error_map_file(out)) {
+            ErrorMapFile::write(batch, out);
+            std::cerr << batch.size() << " error maps (" << model.expected_bits() << " bits expected) written to " << out << std::endl;
+        } else {
+            std::ofstream file(out);
+            batch.write_text(file);
+            if (!file.good()) {
+                std::cerr << "[Error] Cannot write " << out << std::endl;
+                return 1;
+            }
+            std::cerr << batch.size() << " error maps (" << model.expected_bits() << " bits expected) written to " << out << std::endl;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "[Error] " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
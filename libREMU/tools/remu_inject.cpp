@@ -0,0 +1,159 @@
+// remu_inject: inject radiation-induced bit flips into an unmodified running process.
+//
+//   remu_inject -p <pid> (-r <vaddr>:<size> | -m <mapping name>) -t <tree mapping .yaml>
+//               -e <error_counts.txt | .emap> -l <line> [-b <flip bit>] [-g <dram GB>] [-o <log file>]
+//               [-j <stats.json>]
+//
+// The ROI is either an explicit virtual range of the target or every /proc/<pid>/maps entry whose
+// path contains <mapping name> (e.g., the mmap-ed engine file). Requires CAP_SYS_ADMIN for the
+// target's pagemap and ptrace access for process_vm_writev. -j writes the per-phase times and the
+// counters of the injection (Stats) as JSON.
+#include "../mem_utils.h"
+#include "../error_model.h"
+#include "../logger.h"
+#include "../stats.h"
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <map>
+#include <cstdlib>
+#include <cerrno>
+#include <climits>
+#include <getopt.h>
+
+static std::map<int, int> loadErrors(const std::string& file, int lineidx) {
+    try {
+        return ErrorMapFile::load(file, lineidx);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return std::map<int, int>();
+    }
+}
+
+// the address range covered by the target's mappings whose path contains `name`
+static bool findMapping(pid_t pid, const std::string& name, uintptr_t& start, size_t& size) {
+    std::ifstream maps("/proc/" + std::to_string(pid) + "/maps");
+    std::string line;
+    uintptr_t lo = 0, hi = 0;
+    while (std::getline(maps, line)) {
+        if (line.find(name) == std::string::npos) continue;
+        size_t dash = line.find('-');
+        size_t space = line.find(' ');
+        uintptr_t s = std::stoull(line.substr(0, dash), nullptr, 16);
+        uintptr_t e = std::stoull(line.substr(dash + 1, space - dash - 1), nullptr, 16);
+        if (hi == 0) lo = s;
+        else if (s != hi) break; // keep the first contiguous run
+        hi = e;
+    }
+    start = lo;
+    size = hi - lo;
+    return hi != 0;
+}
+
+// the whole of `text` as a non-negative number (base 0 also takes 0x.. and 0..)
+static bool parse_number(const char* text, uint64_t& value, int base = 10) {
+    char* end;
+    errno = 0;
+    unsigned long long v = std::strtoull(text, &end, base);
+    value = v;
+    return end != text && *end == '\0' && errno == 0 && text[0] != '-';
+}
+
+static bool parse_number(const char* text, int& value) {
+    uint64_t v;
+    if (!parse_number(text, v) || v > uint64_t(INT_MAX)) return false;
+    value = int(v);
+    return true;
+}
+
+static void usage() {
+    std::cerr << "./remu_inject -p <pid> (-r <vaddr>:<size> | -m <mapping name>) -t <mapping.yaml> "
+                 "-e <error_counts.txt> -l <line> [-b <flip bit>] [-g <dram GB>] [-o <log file>] [-j <stats.json>]" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    pid_t pid = 0;
+    std::string range, mapname, tree_mapping, error_file, log_file = "remu_inject.log", stats_file;
+    int lineidx = 1, flip_bit = 7;
+    size_t dram_capacity_gb = 64;
+    int opt;
+    while ((opt = getopt(argc, argv, "p:r:m:t:e:l:b:g:o:j:h")) != -1) {
+        bool ok = true;
+        int value = 0;
+        uint64_t gb = 0;
+        switch (opt) {
+            case 'p': ok = parse_number(optarg, value) && value > 0; pid = value; break;
+            case 'r': range = optarg; break;
+            case 'm': mapname = optarg; break;
+            case 't': tree_mapping = optarg; break;
+            case 'e': error_file = optarg; break;
+            case 'l': ok = parse_number(optarg, lineidx); break;
+            // the flip mask is 1 << flip_bit in one byte
+            case 'b': ok = parse_number(optarg, flip_bit) && flip_bit <= 7; break;
+            case 'g': ok = parse_number(optarg, gb) && gb <= SIZE_MAX; dram_capacity_gb = size_t(gb); break;
+            case 'o': log_file = optarg; break;
+            case 'j': stats_file = optarg; break;
+            default: usage(); return -1;
+        }
+        if (!ok) {
+            std::cerr << "[Error] Bad value for -" << char(opt) << ": " << optarg << std::endl;
+            usage();
+            return -1;
+        }
+    }
+    if (pid <= 0 || (range.empty() == mapname.empty()) || tree_mapping.empty() || error_file.empty()) {
+        usage();
+        return -1;
+    }
+
+    uintptr_t Vaddr = 0;
+    size_t size = 0;
+    if (!range.empty()) {
+        size_t colon = range.find(':');
+        uint64_t start = 0, length = 0;
+        if (colon == std::string::npos || !parse_number(range.substr(0, colon).c_str(), start, 0) ||
+            !parse_number(range.substr(colon + 1).c_str(), length, 0) || length == 0) {
+            std::cerr << "[Error] Bad value for -r: " << range << std::endl;
+            usage();
+            return -1;
+        }
+        Vaddr = uintptr_t(start);
+        size = size_t(length);
+    } else if (!findMapping(pid, mapname, Vaddr, size)) {
+        std::cerr << "No mapping matching \"" << mapname << "\" in /proc/" << pid << "/maps" << std::endl;
+        return -1;
+    }
+
+    std::map<int, int> errorMap = loadErrors(error_file, lineidx);
+    int total_bits = 0;
+    for (const auto& pair : errorMap) total_bits += pair.first * pair.second;
+    if (total_bits == 0) {
+        std::cerr << "Empty error map at line " << lineidx << " of " << error_file << std::endl;
+        return -1;
+    }
+
+    std::ofstream logfile(log_file);
+    if (!logfile.is_open()) {
+        std::cerr << "Failed to open log file" << std::endl;
+        return -1;
+    }
+    std::cout << "target " << pid << " roi: " << std::hex << Vaddr << "-" << std::dec << size << std::endl;
+    MemUtils memUtils(dram_capacity_gb);
+    memUtils.attach(pid);
+    size_t applied = 0;
+    std::vector<Vmem> errors = MemUtils::get_error_Va_tree(&memUtils, Vaddr, size, logfile, total_bits, flip_bit, tree_mapping, errorMap, &applied);
+    // the injection log is written asynchronously into logfile
+    Logger::sync();
+    // errors on the same byte are merged into one flip, and the applier can drop flips
+    std::cout << std::dec << errors.size() << " errors planned, " << applied << " bytes flipped in pid " << pid << std::endl;
+    if (!stats_file.empty()) {
+        std::ofstream stats(stats_file);
+        Stats::snapshot().write_json(stats);
+        stats << std::endl;
+        if (!stats) {
+            std::cerr << "Failed to write " << stats_file << std::endl;
+            return -1;
+        }
+    }
+    return 0;
+}
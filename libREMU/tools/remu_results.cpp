@@ -0,0 +1,150 @@
+// remu_results: query a campaign results file (.rres, ResultsWriter).
+//
+//   remu_results [-g <golden metric>] [-T <tolerance>] <results.rres>
+//   remu_results -c <column,...> [-w <outcome>] [-g <golden metric>] [-T <tolerance>] <results.rres>
+//   remu_results -p <trial> <results.rres>
+//
+// Without -c it prints the outcome counts and rates and the metric and time statistics. -c prints
+// the listed columns (seed, map, flips, outcome, metric, seconds) as CSV, -w keeps the trials with
+// one outcome (completed, masked, sdc, crashed, hung). With -g completed trials are classified as
+// masked or sdc against the golden metric minus the tolerance. -p prints the planned flips of a trial.
+// Only the columns a query needs are read.
+#include "../results_store.h"
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <limits>
+#include <stdexcept>
+#include <getopt.h>
+
+static void usage() {
+    std::cerr << "./remu_results [-g <golden metric>] [-T <tolerance>] <results.rres>" << std::endl;
+    std::cerr << "./remu_results -c <seed,map,flips,outcome,metric,seconds> [-w <outcome>] [-g <golden metric>] [-T <tolerance>] <results.rres>" << std::endl;
+    std::cerr << "./remu_results -p <trial> <results.rres>" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    std::string columns, where;
+    double golden = std::numeric_limits<double>::quiet_NaN();
+    double tolerance = 0;
+    long long trial = -1;
+    int opt;
+    while ((opt = getopt(argc, argv, "c:w:g:T:p:")) != -1) {
+        switch (opt) {
+            case 'c': columns = optarg; break;
+            case 'w': where = optarg; break;
+            case 'g': golden = std::stod(optarg); break;
+            case 'T': tolerance = std::stod(optarg); break;
+            case 'p': trial = std::stoll(optarg); break;
+            default: usage(); return 1;
+        }
+    }
+    if (optind + 1 != argc || (!where.empty() && columns.empty())) {
+        usage();
+        return 1;
+    }
+
+    try {
+        ResultsFile results(argv[optind]);
+        if (results.recovered()) {
+            std::cerr << "[Warning] " << argv[optind] << " was not closed, " << results.size() << " trials recovered." << std::endl;
+        }
+        const size_t n = results.size();
+
+        if (trial >= 0) {
+            std::vector<Vflip> plan = results.plan(size_t(trial));
+            std::cout << "vaddr,paddr,mask" << std::endl;
+            for (const Vflip& f : plan) {
+                std::cout << std::hex << "0x" << f.vaddr << ",0x" << f.paddr << ",0x" << unsigned(f.mask) << std::dec << '\n';
+            }
+            return 0;
+        }
+
+        // outcomes and metrics are read once when a query needs them
+        std::vector<TrialRecord::Outcome> outcomes;
+        std::vector<double> metrics;
+        const bool classify = golden == golden;
+        auto need_outcomes = [&]() {
+            if (!outcomes.empty() || n == 0) return;
+            outcomes = results.outcomes();
+            if (classify) {
+                if (metrics.empty()) metrics = results.metrics();
+                for (size_t i = 0; i < n; i++) outcomes[i] = ResultsFile::classify(outcomes[i], metrics[i], golden, tolerance);
+            }
+        };
+
+        if (columns.empty()) {
+            need_outcomes();
+            if (metrics.empty()) metrics = results.metrics();
+            std::vector<double> seconds = results.seconds();
+            size_t count[int(TrialRecord::Outcome::MAX) + 1] = {0};
+            double sum = 0, total_seconds = 0;
+            double low = std::numeric_limits<double>::infinity(), high = -low;
+            size_t finished = 0;
+            for (size_t i = 0; i < n; i++) {
+                count[int(outcomes[i])]++;
+                total_seconds += seconds[i];
+                if (outcomes[i] == TrialRecord::Outcome::Crashed || outcomes[i] == TrialRecord::Outcome::Hung) continue;
+                finished++;
+                sum += metrics[i];
+                low = std::min(low, metrics[i]);
+                high = std::max(high, metrics[i]);
+            }
+            std::cout << n << " trials in " << results.blocks() << " blocks, " << total_seconds << " s" << std::endl;
+            for (int o = 0; o <= int(TrialRecord::Outcome::MAX); o++) {
+                if (count[o] == 0) continue;
+                std::cout << "  " << TrialRecord::outcome_str(TrialRecord::Outcome(o)) << ": " << count[o]
+                          << " (" << 100.0 * count[o] / n << "%)" << std::endl;
+            }
+            if (finished) {
+                std::cout << "metric: mean " << sum / finished << ", min " << low << ", max " << high << std::endl;
+            }
+            return 0;
+        }
+
+        // the listed columns, in order
+        std::vector<std::string> names;
+        std::stringstream list(columns);
+        for (std::string name; std::getline(list, name, ',');) names.push_back(name);
+        std::vector<uint64_t> seeds;
+        std::vector<uint32_t> maps, flips;
+        std::vector<double> seconds;
+        for (const std::string& name : names) {
+            if (name == "seed") seeds = results.seeds();
+            else if (name == "map") maps = results.map_ids();
+            else if (name == "flips") flips = results.flips();
+            else if (name == "outcome") need_outcomes();
+            else if (name == "metric") { if (metrics.empty()) metrics = results.metrics(); }
+            else if (name == "seconds") seconds = results.seconds();
+            else throw std::invalid_argument("Unknown column " + name);
+        }
+        TrialRecord::Outcome filter = TrialRecord::Outcome::MAX;
+        if (!where.empty()) {
+            filter = TrialRecord::parse_outcome(where);
+            need_outcomes();
+        }
+
+        std::cout << "trial";
+        for (const std::string& name : names) std::cout << ',' << name;
+        std::cout << '\n';
+        for (size_t i = 0; i < n; i++) {
+            if (filter != TrialRecord::Outcome::MAX && outcomes[i] != filter) continue;
+            std::cout << i;
+            for (const std::string& name : names) {
+                std::cout << ',';
+                if (name == "seed") std::cout << seeds[i];
+                else if (name == "map") std::cout << maps[i];
+                else if (name == "flips") std::cout << flips[i];
+                else if (name == "outcome") std::cout << TrialRecord::outcome_str(outcomes[i]);
+                else if (name == "metric") std::cout << metrics[i];
+                else std::cout << seconds[i];
+            }
+            std::cout << '\n';
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "[Error] " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,263 @@
+#include "trial_guard.h"
+#include "logger.h"
+#include <stdexcept>
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+// a realtime signal, so it does not collide with alarm()/SIGALRM users
+const int TrialGuard::signals[5] = {SIGSEGV, SIGBUS, SIGFPE, SIGABRT, SIGRTMIN + 3};
+static const int WATCHDOG = 4;
+TrialGuard* volatile TrialGuard::active = nullptr;
+
+TrialGuard::TrialGuard(const Policy& policy, Isolation isolation)
+    : policy(policy), mode(isolation), escalation(false), armed(0), owner(pthread_self()), timer_id(0)
+{
+    if (active != nullptr) {
+        throw std::logic_error("TrialGuard: another guard is already installed");
+    }
+    std::memset(&counters, 0, sizeof(counters));
+    // the handler runs on its own stack, so a fault from a stack overflow is still caught
+    alt_stack.resize(std::max<size_t>(SIGSTKSZ, 64 * 1024));
+
+    struct sigaction sa;
+    std::memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = on_signal;
+    sa.sa_flags = SA_SIGINFO | SA_ONSTACK;
+    sigemptyset(&sa.sa_mask);
+    active = this;
+    for (int i = 0; i < 5; i++) {
+        sigaction(signals[i], &sa, &old_actions[i]);
+    }
+}
+
+TrialGuard::~TrialGuard() {
+    for (int i = 0; i < 5; i++) {
+        sigaction(signals[i], &old_actions[i], nullptr);
+    }
+    active = nullptr;
+}
+
+const char* TrialGuard::outcome_str(Outcome outcome) {
+    switch (outcome) {
+        case Outcome::Completed: return "completed";
+        case Outcome::Crashed: return "crashed";
+        case Outcome::Hung: return "hung";
+        default: return "unknown";
+    }
+}
+
+void TrialGuard::on_signal(int sig, siginfo_t* info, void* context) {
+    (void)context;
+    TrialGuard* guard = active;
+    if (sig == signals[WATCHDOG] && info->si_code == SI_TIMER) {
+        // an expiry that raced with the end of its trial is dropped
+        if (guard != nullptr && guard->armed && info->si_value.sival_int == guard->timer_id) {
+            guard->armed = 0;
+            siglongjmp(guard->env, sig);
+        }
+        return;
+    }
+    if (guard != nullptr && guard->armed && pthread_equal(pthread_self(), guard->owner)) {
+        guard->armed = 0;
+        siglongjmp(guard->env, sig);
+    }
+    // not a guarded trial: restore the previous action, the signal is delivered again to it
+    // (a fault re-executes, a raise() stays pending until this handler returns)
+    for (int i = 0; i < 5; i++) {
+        if (signals[i] == sig) {
+            sigaction(sig, guard != nullptr ? &guard->old_actions[i] : nullptr, nullptr);
+        }
+    }
+    if (guard == nullptr) {
+        signal(sig, SIG_DFL);
+    }
+    if (info->si_code <= 0) { // sent by kill/raise/abort rather than by a faulting instruction
+        raise(sig);
+    }
+}
+
+void TrialGuard::record(const std::vector<Vflip>& flips, const FlipApplier& applier) {
+    if (flips.empty()) return;
+    JournalEntry entry = {flips, applier};
+    journal.push_back(entry);
+}
+
+void TrialGuard::revert() {
+    for (size_t i = journal.size(); i-- > 0;) {
+        counters.reverted += journal[i].applier.apply(journal[i].flips);
+    }
+    journal.clear();
+}
+
+TrialGuard::Result TrialGuard::run(const std::function<int()>& trial, double deadline) {
+    counters.trials++;
+    if (mode == Isolation::Fork) {
+        return run_forked(trial, deadline);
+    }
+
+    stack_t ss;
+    ss.ss_sp = alt_stack.data();
+    ss.ss_size = alt_stack.size();
+    ss.ss_flags = 0;
+    sigaltstack(&ss, &old_stack);
+    owner = pthread_self();
+
+    // the watchdog signal goes to this thread only, other threads of the process keep running
+    timer_t timer;
+    bool timed = false;
+    if (deadline > 0) {
+        struct sigevent sev;
+        std::memset(&sev, 0, sizeof(sev));
+        sev.sigev_notify = SIGEV_THREAD_ID;
+        sev.sigev_signo = signals[WATCHDOG];
+        sev.sigev_value.sival_int = int(counters.trials);
+        sev.sigev_notify_thread_id = syscall(SYS_gettid);
+        timed = timer_create(CLOCK_MONOTONIC, &sev, &timer) == 0;
+        if (!timed) {
+            std::cerr << "[Warn] trial guard: no watchdog timer: " << std::strerror(errno) << std::endl;
+        }
+    }
+
+    Result result;
+    result.forked = false;
+    int status = 0;
+    // the mask is saved, so the signal is unblocked again after the jump
+    int sig = sigsetjmp(env, 1);
+    if (sig == 0) {
+        timer_id = int(counters.trials);
+        armed = 1;
+        if (timed) {
+            struct itimerspec its;
+            std::memset(&its, 0, sizeof(its));
+            its.it_value.tv_sec = time_t(deadline);
+            its.it_value.tv_nsec = long((deadline - double(its.it_value.tv_sec)) * 1e9);
+            timer_settime(timer, 0, &its, nullptr);
+        }
+        try {
+            status = trial();
+        } catch (...) {
+            armed = 0;
+            if (timed) timer_delete(timer);
+            sigaltstack(&old_stack, nullptr);
+            revert();
+            throw;
+        }
+        armed = 0;
+        result.outcome = Outcome::Completed;
+        result.signal = 0;
+        result.status = status;
+    } else if (sig == signals[WATCHDOG]) {
+        result.outcome = Outcome::Hung;
+        result.signal = 0;
+        result.status = -1;
+    } else {
+        result.outcome = Outcome::Crashed;
+        result.signal = sig;
+        result.status = -1;
+    }
+    if (timed) timer_delete(timer);
+    sigaltstack(&old_stack, nullptr);
+    revert();
+    counters.outcome[int(result.outcome)]++;
+
+    const char* reason = nullptr;
+    size_t crashes = counters.outcome[int(Outcome::Crashed)];
+    if (result.outcome == Outcome::Hung && policy.fork_on_hang) {
+        reason = "hang";
+    } else if (result.outcome == Outcome::Crashed && sig == SIGABRT && policy.fork_on_abort) {
+        reason = "SIGABRT";
+    } else if (result.outcome == Outcome::Crashed && policy.max_crashes > 0 && crashes >= size_t(policy.max_crashes)) {
+        reason = "too many crashes";
+    }
+    if (reason != nullptr && !escalation) {
+        escalation = true;
+        if (policy.fork) {
+            std::cerr << "[Warn] trial guard: " << reason << ", later trials run in a child process." << std::endl;
+            mode = Isolation::Fork;
+        } else {
+            std::cerr << "[Warn] trial guard: " << reason << ", the process state may be damaged." << std::endl;
+        }
+    }
+    return result;
+}
+
+TrialGuard::Result TrialGuard::run_forked(const std::function<int()>& trial, double deadline) {
+    Result result;
+    result.forked = true;
+    // buffered output would otherwise be written by both processes
+    Logger::sync();
+    std::cout.flush();
+    std::cerr.flush();
+    std::fflush(nullptr);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        throw std::runtime_error("TrialGuard: fork failed: " + std::string(std::strerror(errno)));
+    }
+    if (pid == 0) {
+        // a fault in the child is not armed, so it dies from the signal
+        int status = 0;
+        try {
+            status = trial();
+        } catch (...) {
+            std::abort();
+        }
+        Logger::sync();
+        std::cout.flush();
+        std::cerr.flush();
+        std::fflush(nullptr);
+        _exit(status & 0xff);
+    }
+
+    // poll the child, so a hung one can be killed at the deadline
+    struct timespec begin, now;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    bool hung = false;
+    int wstatus = 0;
+    for (long nap_us = 100;;) {
+        pid_t done = waitpid(pid, &wstatus, deadline > 0 ? WNOHANG : 0);
+        if (done == pid) break;
+        if (done < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error("TrialGuard: waitpid failed: " + std::string(std::strerror(errno)));
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double elapsed = double(now.tv_sec - begin.tv_sec) + double(now.tv_nsec - begin.tv_nsec) * 1e-9;
+        if (!hung && elapsed >= deadline) {
+            kill(pid, SIGKILL);
+            hung = true;
+        }
+        usleep(useconds_t(nap_us));
+        nap_us = std::min(nap_us * 2, 10000L);
+    }
+    if (hung && WIFSIGNALED(wstatus) && WTERMSIG(wstatus) == SIGKILL) {
+        result.outcome = Outcome::Hung;
+        result.signal = 0;
+        result.status = -1;
+    } else if (WIFSIGNALED(wstatus)) {
+        result.outcome = Outcome::Crashed;
+        result.signal = WTERMSIG(wstatus);
+        result.status = -1;
+    } else {
+        result.outcome = Outcome::Completed;
+        result.signal = 0;
+        result.status = WEXITSTATUS(wstatus);
+    }
+    counters.forked++;
+    counters.outcome[int(result.outcome)]++;
+    // flips applied in the child never reached this process, only those journaled here are reverted
+    revert();
+    return result;
+}
@@ -0,0 +1,123 @@
+#ifndef TRIAL_GUARD_H
+#define TRIAL_GUARD_H
+
+#include <vector>
+#include <functional>
+#include <cstddef>
+#include <csetjmp>
+#include <csignal>
+#include <pthread.h>
+#include "flip_apply.h"
+
+/**
+ * Optional crash containment for injected trials.
+ *
+ * A trial runs under SIGSEGV/SIGBUS/SIGFPE/SIGABRT handlers on an alternate stack. A fault in
+ * the trial's thread jumps back (siglongjmp) to run(), which classifies the trial as a crash,
+ * reverts the journal of applied flips and returns, so the campaign continues in the same
+ * process. Objects the trial left half-built are not destroyed (their memory leaks).
+ *
+ * A trial can also be given a deadline. In process, a per-thread POSIX timer raises the
+ * watchdog signal in the trial's thread and the trial is reported as hung; a forked trial is
+ * killed with SIGKILL.
+ *
+ * When the process state is likely unrecoverable (SIGABRT, usually the allocator detecting
+ * corruption, a hang, or too many crashes) the guard escalates: every later trial runs in a
+ * forked child and is classified from its exit status. State that does not survive fork (e.g. an
+ * initialized CUDA context) is not usable in forked trials; such callers turn Policy::fork off,
+ * check escalated() after each trial and restart the process instead.
+ */
+class TrialGuard {
+public:
+    enum class Outcome {
+        Completed, // the trial returned
+        Crashed,   // fatal signal in the trial (or the forked child died from one)
+        Hung,      // deadline expired
+        MAX
+    };
+
+    enum class Isolation {
+        InProcess, // sigsetjmp/siglongjmp in the calling process
+        Fork,      // one child process per trial
+    };
+
+    struct Policy {
+        bool fork_on_abort; // escalate after a SIGABRT
+        bool fork_on_hang;  // escalate after a hang (the abandoned trial may hold locks)
+        int max_crashes;    // escalate after this many in-process crashes, 0 never
+        bool fork;          // run the trials after an escalation in a child; false only sets escalated()
+        Policy() : fork_on_abort(true), fork_on_hang(true), max_crashes(8), fork(true) {}
+    };
+
+    struct Result {
+        Outcome outcome;
+        int signal;   // fatal signal of a crash, 0 otherwise
+        int status;   // return value of the trial (exit status, 0-255, when forked)
+        bool forked;
+    };
+
+    struct Stats {
+        size_t trials;
+        size_t outcome[int(Outcome::MAX)];
+        size_t forked;       // trials run in a child
+        size_t reverted;     // journal bytes restored
+    };
+
+    // installs the handlers; only one guard may exist at a time (std::logic_error otherwise)
+    explicit TrialGuard(const Policy& policy = Policy(), Isolation isolation = Isolation::InProcess);
+    // restores the previous handlers and signal stack
+    ~TrialGuard();
+    TrialGuard(const TrialGuard&) = delete;
+    TrialGuard& operator=(const TrialGuard&) = delete;
+
+    /**
+     * Run one trial and revert the flips journaled during it. The trial's return value is
+     * reported as Result::status. A positive `deadline` (seconds) arms the hang watchdog,
+     * e.g. the golden-run latency times a safety factor.
+    */
+    Result run(const std::function<int()>& trial, double deadline = 0);
+
+    /**
+     * Journal flips that were applied with `applier` (MemUtils::inject does this when
+     * MemUtils::guard is set). Flips are XOR masks, so reverting re-applies them.
+    */
+    void record(const std::vector<Vflip>& flips, const FlipApplier& applier);
+    // re-apply the journal in reverse order and clear it
+    void revert();
+
+    Isolation isolation() const { return mode; }
+    // force fork isolation, e.g. when the caller knows its state is damaged
+    void escalate() { mode = Isolation::Fork; escalation = true; }
+    // an escalation happened (with Policy::fork off the trials still run in process)
+    bool escalated() const { return escalation; }
+    const Stats& stats() const { return counters; }
+    static const char* outcome_str(Outcome outcome);
+
+private:
+    struct JournalEntry {
+        std::vector<Vflip> flips;
+        FlipApplier applier;
+    };
+
+    Policy policy;
+    Isolation mode;
+    bool escalation;
+    Stats counters;
+    std::vector<JournalEntry> journal;
+
+    sigjmp_buf env;
+    volatile sig_atomic_t armed;
+    pthread_t owner;
+    volatile sig_atomic_t timer_id; // sigev value of the current watchdog, stale expiries are ignored
+    std::vector<char> alt_stack;
+    stack_t old_stack;
+    struct sigaction old_actions[5];
+
+    static const int signals[5]; // the fatal signals and the watchdog signal (last)
+    static TrialGuard* volatile active;
+    static void on_signal(int sig, siginfo_t* info, void* context);
+
+    Result run_forked(const std::function<int()>& trial, double deadline);
+};
+
+#endif // TRIAL_GUARD_H